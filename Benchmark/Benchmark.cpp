@@ -0,0 +1,22 @@
+#include "stdafx.h"
+#include "MergeBenchmark.h"
+#include "CompareBenchmark.h"
+#include "ContentHashCheck.h"
+
+
+
+// Measures hot paths of scan and comparison outside of the application,
+// on synthetic data, so that nothing is read from disk
+// Results, that can be checked against reference values, are checked first
+// Times are meaningful for Release build only
+// Exit code is not 0 if any check fails or measured variants disagree
+int _tmain(int argc, TCHAR* argv[])
+{
+    BOOL passed = TRUE;
+
+    passed = checkContentHash() && passed;
+    passed = benchmarkMerge() && passed;
+    passed = benchmarkCompare() && passed;
+
+    return passed ? 0 : 1;
+}
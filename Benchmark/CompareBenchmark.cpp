@@ -0,0 +1,201 @@
+#include "stdafx.h"
+#include "CompareBenchmark.h"
+#include "Stopwatch.h"
+#include "sync\FileComparator.h"
+
+#include <list>
+#include <vector>
+#include <algorithm>
+
+
+
+static const UINT PAIR_COUNT = 100000;
+static const UINT PASSES = 20;
+static const UINT RUNS = 5;
+
+static const ULONGLONG FILETIME_TICKS_PER_SECOND = 10000000;
+
+// Times differ by whole hours, far beyond time tolerance,
+// so that CTime and FILETIME comparisons agree
+static const ULONGLONG TIME_DIFFERENCE = 3600 * FILETIME_TICKS_PER_SECOND;
+
+
+using COMPARISON = FileProperties::COMPARISON_RESULT;
+
+struct FilePair
+{
+    FileProperties first;
+    FileProperties second;
+};
+
+// Number of pairs with each result, in order of COMPARISON_RESULT
+struct ComparisonCounts
+{
+    ULONGLONG results[4] = {};
+
+    BOOL operator== (const ComparisonCounts& counts) const
+    {
+        return std::equal(results, results + _countof(results), counts.results);
+    }
+};
+
+
+
+static std::vector<FilePair> makePairs()
+{
+    PathNode::ptr firstFolder = PathNode::makeRoot(_T("C:\\Source"));
+    PathNode::ptr secondFolder = PathNode::makeRoot(_T("D:\\Destination"));
+
+    std::vector<FilePair> pairs;
+    pairs.reserve(PAIR_COUNT);
+
+    for (UINT index = 0; index < PAIR_COUNT; ++index)
+    {
+        CString name;
+        name.Format(_T("File %06u.dat"), index);
+
+        FileEntryInfo info;
+        info.size = index * 1024ULL;
+        info.lastWriteTime = 131000000000000000ULL + index * FILETIME_TICKS_PER_SECOND;
+        info.attributes = FILE_ATTRIBUTE_ARCHIVE;
+
+        // Mix of all four results: equal, newer, older, undefined
+        FileEntryInfo otherInfo = info;
+        if (index % 3 == 0)
+            otherInfo.size += 512;
+        if (index % 4 == 0)
+            otherInfo.lastWriteTime += TIME_DIFFERENCE;
+        else if (index % 7 == 0)
+            otherInfo.lastWriteTime -= TIME_DIFFERENCE;
+
+        pairs.push_back({ FileProperties(firstFolder, name, info),
+                          FileProperties(secondFolder, name, otherInfo) });
+    }
+
+    return pairs;
+}
+
+
+
+// FileProperties::compareTo() and makeChoice() before FileComparator
+static COMPARISON compareWithList(const FileProperties& first,
+                                  const FileProperties& second,
+                                  const FileComparisonParameters& params)
+{
+    BOOL equalNames = first.getFileName() == second.getFileName();
+    if (!equalNames)
+        return COMPARISON::UNDEFINED;
+
+    std::list<COMPARISON> results;
+
+    if (params.m_compareSize)
+        results.push_back(FileProperties::compareProperty(first.getSize(),
+                                                          second.getSize()));
+
+    if (params.m_compareTime)
+    {
+        COMPARISON timeCompare = COMPARISON::EQUAL;
+
+        switch (params.m_timeToCompare)
+        {
+        case FileProperties::TIME_STAMP::CREATION_TIME:
+            timeCompare = FileProperties::compareProperty(first.getCreationTime(),
+                                                          second.getCreationTime());
+            break;
+        case FileProperties::TIME_STAMP::LAST_ACCESS_TIME:
+            timeCompare = FileProperties::compareProperty(first.getLastAccessTime(),
+                                                          second.getLastAccessTime());
+            break;
+        case FileProperties::TIME_STAMP::LAST_WRITE_TIME:
+            timeCompare = FileProperties::compareProperty(first.getLastWriteTime(),
+                                                          second.getLastWriteTime());
+            break;
+        }
+
+        results.push_back(timeCompare);
+    }
+
+    results.remove(COMPARISON::EQUAL);
+
+    if (results.empty())
+        return COMPARISON::EQUAL;
+
+    BOOL hasPreferable = std::find(results.begin(), results.end(),
+                                   COMPARISON::PREFERABLE) != results.end();
+    BOOL hasNonPreferable = std::find(results.begin(), results.end(),
+                                      COMPARISON::NON_PREFERABLE) != results.end();
+
+    if (hasPreferable)
+        return hasNonPreferable ? COMPARISON::UNDEFINED : COMPARISON::PREFERABLE;
+    else
+        return COMPARISON::NON_PREFERABLE;
+}
+
+
+
+template<class Compare>
+static ComparisonCounts comparePairs(const std::vector<FilePair>& pairs, Compare compare)
+{
+    ComparisonCounts counts;
+
+    for (UINT pass = 0; pass < PASSES; ++pass)
+    {
+        for (const FilePair& pair : pairs)
+            ++counts.results[(int)compare(pair.first, pair.second)];
+    }
+
+    return counts;
+}
+
+BOOL benchmarkCompare()
+{
+    std::vector<FilePair> pairs = makePairs();
+
+    FileComparisonParameters params;
+    params.m_compareSize = TRUE;
+    params.m_compareTime = TRUE;
+    params.m_timeToCompare = FileProperties::TIME_STAMP::LAST_WRITE_TIME;
+
+    FileComparator comparator(params);
+
+    ComparisonCounts listCounts;
+    ComparisonCounts comparatorCounts;
+    ComparisonCounts compareToCounts;
+
+    double listTime = measureBest(RUNS, [&]() {
+        listCounts = comparePairs(pairs, [&](const FileProperties& first,
+                                             const FileProperties& second) {
+            return compareWithList(first, second, params);
+        });
+    });
+    double comparatorTime = measureBest(RUNS, [&]() {
+        comparatorCounts = comparePairs(pairs, [&](const FileProperties& first,
+                                                   const FileProperties& second) {
+            return comparator.compare(first, second);
+        });
+    });
+    double compareToTime = measureBest(RUNS, [&]() {
+        compareToCounts = comparePairs(pairs, [&](const FileProperties& first,
+                                                  const FileProperties& second) {
+            return first.compareTo(second, params);
+        });
+    });
+
+    double comparisons = (double)PAIR_COUNT * PASSES;
+
+    _tprintf(_T("Comparison of %u pairs by size and write time, %u passes, best of %u runs\n"),
+             PAIR_COUNT, PASSES, RUNS);
+    _tprintf(_T("  std::list and CTime:      %10.1f ms, %6.1f M pairs/s\n"),
+             listTime, comparisons / listTime / 1000);
+    _tprintf(_T("  FileComparator:           %10.1f ms, %6.1f M pairs/s\n"),
+             comparatorTime, comparisons / comparatorTime / 1000);
+    _tprintf(_T("  FileProperties::compareTo:%10.1f ms, %6.1f M pairs/s\n"),
+             compareToTime, comparisons / compareToTime / 1000);
+
+    BOOL equalResults = listCounts == comparatorCounts &&
+                        listCounts == compareToCounts;
+    if (!equalResults)
+        _tprintf(_T("  FAILED: variants gave different results\n"));
+
+    return equalResults;
+}
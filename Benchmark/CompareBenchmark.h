@@ -0,0 +1,12 @@
+#pragma once
+
+
+
+// Times comparison of file pairs by size and write time:
+// - criteria checked on every call, results collected into std::list
+//   and times converted to CTime, as FileProperties::compareTo() did
+//   before FileComparator
+// - FileComparator, made once, as SyncManager uses it
+// - FileProperties::compareTo(), which makes FileComparator on every call
+// All variants have to give the same results; returns FALSE if they do not
+BOOL benchmarkCompare();
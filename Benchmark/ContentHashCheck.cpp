@@ -0,0 +1,98 @@
+#include "stdafx.h"
+#include "ContentHashCheck.h"
+#include "sync\ContentHash.h"
+
+#include <vector>
+
+
+
+static const ULONGLONG PRIME32_1 = 0x9E3779B1ULL;
+
+// Input of bytes 0, 1, 2... of this length covers full stripes,
+// then 8-, 4- and 1-byte tails of XXH64
+static const size_t SEQUENCE_LENGTH = 100;
+
+
+struct HashVector
+{
+    LPCTSTR description;
+    std::vector <BYTE> data;
+    ULONGLONG seed;
+    ULONGLONG hash;
+};
+
+
+
+static std::vector<BYTE> makeBytes(const char* text)
+{
+    return std::vector<BYTE>(text, text + strlen(text));
+}
+
+static std::vector<BYTE> makeSequence()
+{
+    std::vector<BYTE> sequence(SEQUENCE_LENGTH);
+    for (size_t i = 0; i < sequence.size(); ++i)
+        sequence[i] = (BYTE)i;
+    return sequence;
+}
+
+// Values given by the reference xxHash implementation
+static std::vector<HashVector> makeVectors()
+{
+    std::vector<BYTE> sequence = makeSequence();
+
+    return {
+        { _T("empty input"), {}, 0, 0xEF46DB3751D8E999ULL },
+        { _T("empty input, seed"), {}, PRIME32_1, 0xAC75FDA2929B17EFULL },
+        { _T("\"abc\""), makeBytes("abc"), 0, 0x44BC2CF5AD770999ULL },
+        { _T("39 bytes of text"), makeBytes("Nobody inspects the spammish repetition"),
+          0, 0xFBCEA83C8A378BF1ULL },
+        { _T("100 bytes"), sequence, 0, 0x6AC1E58032166597ULL },
+        { _T("100 bytes, seed"), sequence, PRIME32_1, 0x8832442A88284F11ULL }
+    };
+}
+
+
+
+static BOOL checkHash(LPCTSTR description, ULONGLONG hash, ULONGLONG expectedHash)
+{
+    BOOL equalHashes = hash == expectedHash;
+    if (!equalHashes)
+        _tprintf(_T("  FAILED: %s: %016llX instead of %016llX\n"),
+                 description, hash, expectedHash);
+
+    return equalHashes;
+}
+
+BOOL checkContentHash()
+{
+    BOOL passed = TRUE;
+    std::vector<HashVector> vectors = makeVectors();
+
+    for (const HashVector& vector : vectors)
+    {
+        ContentHash hash(vector.seed);
+        hash.update(vector.data.data(), vector.data.size());
+
+        passed = checkHash(vector.description, hash.digest(), vector.hash) && passed;
+    }
+
+    // Pieces leave part of a stripe in the buffer, fill it,
+    // and pass whole stripes straight from input
+    const HashVector& longest = vectors.back();
+    const size_t pieceSizes[] = { 1, 7, 31, 33, 28 };
+
+    ContentHash pieces(longest.seed);
+    size_t offset = 0;
+    for (size_t size : pieceSizes)
+    {
+        pieces.update(longest.data.data() + offset, size);
+        offset += size;
+    }
+
+    passed = checkHash(_T("100 bytes in pieces"), pieces.digest(), longest.hash) && passed;
+
+    _tprintf(_T("XXH64 reference values: %s\n"), passed ? _T("passed") : _T("FAILED"));
+
+    return passed;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+
+
+// Checks ContentHash against reference XXH64 values, including input
+// given to update() in pieces that do not match 32-byte stripes
+// Returns FALSE if any value differs
+BOOL checkContentHash();
@@ -0,0 +1,366 @@
+#include "stdafx.h"
+#include "MergeBenchmark.h"
+#include "Stopwatch.h"
+#include "sync\FileTable.h"
+
+#include <set>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+
+
+static const UINT RUNS = 5;
+
+// Entries with index divisible by these exist on one side only
+static const UINT DESTINATION_ONLY_EVERY = 10;
+static const UINT SOURCE_ONLY_EVERY = 15;
+
+// Every such entry is a folder, the rest are files
+static const UINT FOLDER_EVERY = 20;
+
+
+// Entry as enumeration gives it
+struct SyntheticEntry
+{
+    CString name;
+    FileEntryInfo info;
+};
+
+using SyntheticFolder = std::vector <SyntheticEntry>;
+
+struct TreeShape
+{
+    UINT folderCount;
+    UINT entriesPerFolder;
+};
+
+static const TreeShape TREE_SHAPES[] = {
+    {1000, 200},
+    {1, 100000}
+};
+
+struct SyntheticTree
+{
+    std::vector <PathNode::ptr> sourceNodes;
+    std::vector <PathNode::ptr> destinationNodes;
+
+    std::vector <SyntheticFolder> sourceFolders;
+    std::vector <SyntheticFolder> destinationFolders;
+};
+
+// What diff found; total size keeps made FileProperties from being
+// optimized away and is compared too
+struct MergeCounts
+{
+    size_t copies = 0;
+    size_t pairs = 0;
+    size_t removals = 0;
+    ULONGLONG totalSize = 0;
+
+    BOOL operator== (const MergeCounts& counts) const
+    {
+        return copies == counts.copies && pairs == counts.pairs &&
+               removals == counts.removals && totalSize == counts.totalSize;
+    }
+};
+
+
+
+static SyntheticTree makeTree(const TreeShape& shape)
+{
+    SyntheticTree tree;
+
+    PathNode::ptr sourceRoot = PathNode::makeRoot(_T("C:\\Source"));
+    PathNode::ptr destinationRoot = PathNode::makeRoot(_T("D:\\Destination"));
+
+    for (UINT folderIndex = 0; folderIndex < shape.folderCount; ++folderIndex)
+    {
+        CString folderName;
+        folderName.Format(_T("Folder %04u"), folderIndex);
+
+        tree.sourceNodes.push_back(PathNode::make(sourceRoot, folderName));
+        tree.destinationNodes.push_back(PathNode::make(destinationRoot, folderName));
+
+        SyntheticFolder source;
+        SyntheticFolder destination;
+
+        for (UINT index = 0; index < shape.entriesPerFolder; ++index)
+        {
+            SyntheticEntry entry;
+            if (index % FOLDER_EVERY == 0)
+            {
+                entry.name.Format(_T("Subfolder %06u"), index);
+                entry.info.attributes = FILE_ATTRIBUTE_DIRECTORY;
+            }
+            else
+            {
+                entry.name.Format(_T("File %06u.dat"), index);
+                entry.info.attributes = FILE_ATTRIBUTE_ARCHIVE;
+                entry.info.size = index * 1024ULL;
+            }
+            entry.info.creationTime = 131000000000000000ULL;
+            entry.info.lastAccessTime = 131000000000000000ULL + index;
+            entry.info.lastWriteTime = 131000000000000000ULL + index;
+
+            if (index % SOURCE_ONLY_EVERY != 0)
+                destination.push_back(entry);
+            if (index % DESTINATION_ONLY_EVERY != 0)
+                source.push_back(entry);
+        }
+
+        // Enumeration order is up to file system, so both variants sort
+        std::mt19937 random(folderIndex);
+        std::shuffle(source.begin(), source.end(), random);
+        std::shuffle(destination.begin(), destination.end(), random);
+
+        tree.sourceFolders.push_back(std::move(source));
+        tree.destinationFolders.push_back(std::move(destination));
+    }
+
+    return tree;
+}
+
+
+
+// FileProperties as it was before the merge-join: CFileStatus with
+// full path, file name is cut out of it for every comparison
+class OriginalFileProperties
+{
+public:
+    OriginalFileProperties(const CFileStatus& properties)
+        : m_properties(properties)
+    {
+    }
+
+    BOOL operator< (const OriginalFileProperties& file) const
+    {
+        BOOL isThisFolder = this->isFolder();
+        BOOL isFileFolder = file.isFolder();
+
+        if (isThisFolder != isFileFolder)
+            return isThisFolder ? FALSE : TRUE;
+        else
+            return (this->getFileName() < file.getFileName());
+    }
+
+    CString getFileName() const
+    {
+        CString fullPath = m_properties.m_szFullName;
+        int slashPos = fullPath.ReverseFind('\\');
+        return fullPath.Right(fullPath.GetLength() - slashPos - 1);
+    }
+
+    ULONGLONG getSize() const
+    {
+        return m_properties.m_size;
+    }
+
+    BOOL isFolder() const
+    {
+        return (m_properties.m_attribute & CFile::Attribute::directory) ==
+            CFile::Attribute::directory;
+    }
+
+private:
+    CFileStatus m_properties;
+};
+
+static FILETIME toFileTime(ULONGLONG time)
+{
+    FILETIME fileTime;
+    fileTime.dwLowDateTime = (DWORD)time;
+    fileTime.dwHighDateTime = (DWORD)(time >> 32);
+    return fileTime;
+}
+
+// Fills CFileStatus the way CFile::GetStatus() did, except that
+// no file is opened: only building and merging the sets is timed
+static std::set<OriginalFileProperties> makeFileSet(const SyntheticFolder& folder,
+                                                    const PathNode::ptr& node)
+{
+    CString folderPath = node->getFullPath();
+
+    std::set<OriginalFileProperties> files;
+    for (const SyntheticEntry& entry : folder)
+    {
+        CFileStatus status;
+        wcscpy_s(status.m_szFullName, folderPath + _T("\\") + entry.name);
+        status.m_size = entry.info.size;
+        status.m_ctime = CTime(toFileTime(entry.info.creationTime));
+        status.m_atime = CTime(toFileTime(entry.info.lastAccessTime));
+        status.m_mtime = CTime(toFileTime(entry.info.lastWriteTime));
+        status.m_attribute = (BYTE)entry.info.attributes;
+
+        files.insert(OriginalFileProperties(status));
+    }
+    return files;
+}
+
+// Loop of scanFolders() before the merge-join: every source file is looked
+// up in destination set twice, matched files are erased from both sets
+static MergeCounts mergeWithSets(const SyntheticTree& tree)
+{
+    MergeCounts counts;
+
+    for (size_t i = 0; i < tree.sourceFolders.size(); ++i)
+    {
+        std::set<OriginalFileProperties> sourceFiles =
+            makeFileSet(tree.sourceFolders[i], tree.sourceNodes[i]);
+        std::set<OriginalFileProperties> destinationFiles =
+            makeFileSet(tree.destinationFolders[i], tree.destinationNodes[i]);
+
+        for (auto fileIt = sourceFiles.cbegin(); fileIt != sourceFiles.cend(); )
+        {
+            const OriginalFileProperties& file = *fileIt;
+
+            if (destinationFiles.find(file) == destinationFiles.end())
+                ++counts.copies;
+            else
+            {
+                auto sameFileIt = destinationFiles.find(file);
+                counts.totalSize += sameFileIt->getSize();
+                ++counts.pairs;
+
+                destinationFiles.erase(sameFileIt);
+            }
+
+            counts.totalSize += file.getSize();
+            fileIt = sourceFiles.erase(fileIt);
+        }
+
+        for (auto fileIt = destinationFiles.cbegin(); fileIt != destinationFiles.cend(); )
+        {
+            if (sourceFiles.find(*fileIt) == sourceFiles.end())
+            {
+                counts.totalSize += fileIt->getSize();
+                ++counts.removals;
+            }
+
+            fileIt = destinationFiles.erase(fileIt);
+        }
+    }
+
+    return counts;
+}
+
+
+
+static void makeFileTable(const SyntheticFolder& folder,
+                          FileTable& table,
+                          FileTable::Handles& files)
+{
+    table.reserve(folder.size());
+    for (const SyntheticEntry& entry : folder)
+        files.push_back(table.add(entry.name, entry.name.GetLength(), entry.info));
+
+    table.sort(files);
+}
+
+// Loop of scanFolders(): FileProperties are made only for entries,
+// that get into operations, destination-only files are handled last
+static MergeCounts mergeWithTables(const SyntheticTree& tree)
+{
+    MergeCounts counts;
+
+    for (size_t i = 0; i < tree.sourceFolders.size(); ++i)
+    {
+        const PathNode::ptr& source = tree.sourceNodes[i];
+        const PathNode::ptr& destination = tree.destinationNodes[i];
+
+        FileTable sourceTable;
+        FileTable destinationTable;
+        FileTable::Handles sourceFiles;
+        FileTable::Handles destinationFiles;
+
+        makeFileTable(tree.sourceFolders[i], sourceTable, sourceFiles);
+        makeFileTable(tree.destinationFolders[i], destinationTable, destinationFiles);
+
+        FileTable::Handles destinationOnlyFiles;
+
+        auto sourceIt = sourceFiles.cbegin();
+        auto destinationIt = destinationFiles.cbegin();
+
+        while (sourceIt != sourceFiles.cend())
+        {
+            int comparison = -1;
+            if (destinationIt != destinationFiles.cend())
+                comparison = sourceTable.compareNames(*sourceIt, destinationTable, *destinationIt);
+
+            if (comparison > 0)
+            {
+                destinationOnlyFiles.push_back(*destinationIt);
+                ++destinationIt;
+                continue;
+            }
+
+            FileProperties file = sourceTable.makeFileProperties(*sourceIt, source);
+            counts.totalSize += file.getSize();
+
+            if (comparison < 0)
+                ++counts.copies;
+            else
+            {
+                FileProperties sameFile = destinationTable.makeFileProperties(*destinationIt,
+                                                                              destination);
+                counts.totalSize += sameFile.getSize();
+                ++counts.pairs;
+
+                ++destinationIt;
+            }
+
+            ++sourceIt;
+        }
+
+        for (; destinationIt != destinationFiles.cend(); ++destinationIt)
+            destinationOnlyFiles.push_back(*destinationIt);
+
+        for (FileTable::Handle handle : destinationOnlyFiles)
+        {
+            FileProperties file = destinationTable.makeFileProperties(handle, destination);
+            counts.totalSize += file.getSize();
+            ++counts.removals;
+        }
+    }
+
+    return counts;
+}
+
+
+
+static BOOL benchmarkTree(const TreeShape& shape)
+{
+    SyntheticTree tree = makeTree(shape);
+
+    MergeCounts setCounts;
+    MergeCounts tableCounts;
+
+    double setTime = measureBest(RUNS, [&]() {
+        setCounts = mergeWithSets(tree);
+    });
+    double tableTime = measureBest(RUNS, [&]() {
+        tableCounts = mergeWithTables(tree);
+    });
+
+    _tprintf(_T("Merge of %u folders, %u entries each, best of %u runs\n"),
+             shape.folderCount, shape.entriesPerFolder, RUNS);
+    _tprintf(_T("  std::set of CFileStatus, find and erase: %10.1f ms\n"), setTime);
+    _tprintf(_T("  FileTable merge-join:                    %10.1f ms\n"), tableTime);
+    _tprintf(_T("  copies %Iu, pairs %Iu, removals %Iu\n"),
+             tableCounts.copies, tableCounts.pairs, tableCounts.removals);
+
+    BOOL equalResults = setCounts == tableCounts;
+    if (!equalResults)
+        _tprintf(_T("  FAILED: variants found different operations\n"));
+
+    return equalResults;
+}
+
+BOOL benchmarkMerge()
+{
+    BOOL succeeded = TRUE;
+    for (const TreeShape& shape : TREE_SHAPES)
+        succeeded = benchmarkTree(shape) && succeeded;
+
+    return succeeded;
+}
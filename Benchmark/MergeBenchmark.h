@@ -0,0 +1,13 @@
+#pragma once
+
+
+
+// Times diff of source and destination folder contents on synthetic
+// trees, the way SyncManager::scanFolders() did it before and does it now:
+// - std::set of original CFileStatus-based file properties per side,
+//   find() and erase() for each file
+// - FileTable per side, handles sorted once and merged in one pass
+// Trees are many ordinary folders and one folder of 100000 entries
+// Both variants have to find the same copies, pairs and removals;
+// returns FALSE if they do not
+BOOL benchmarkMerge();
@@ -0,0 +1,23 @@
+#include "stdafx.h"
+#include "Stopwatch.h"
+
+
+
+Stopwatch::Stopwatch()
+{
+    QueryPerformanceFrequency(&m_frequency);
+    restart();
+}
+
+void Stopwatch::restart()
+{
+    QueryPerformanceCounter(&m_start);
+}
+
+double Stopwatch::getMilliseconds() const
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    return (now.QuadPart - m_start.QuadPart) * 1000.0 / m_frequency.QuadPart;
+}
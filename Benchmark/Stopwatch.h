@@ -0,0 +1,38 @@
+#pragma once
+
+
+
+// Wall clock time since construction or restart(), by performance counter
+class Stopwatch
+{
+public:
+    Stopwatch();
+
+    void restart();
+    double getMilliseconds() const;
+
+private:
+    LARGE_INTEGER m_frequency;
+    LARGE_INTEGER m_start;
+};
+
+
+// Runs action given number of times and returns the fastest run,
+// so that a single run, interrupted by the system, does not count
+template<class Action>
+double measureBest(UINT runs, Action action)
+{
+    double best = 0;
+
+    for (UINT run = 0; run < runs; ++run)
+    {
+        Stopwatch stopwatch;
+        action();
+
+        double elapsed = stopwatch.getMilliseconds();
+        if (run == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+}
@@ -0,0 +1,4 @@
+// stdafx.cpp: source file that includes just the standard includes
+// stdafx.obj will contain the pre-compiled type information
+
+#include "stdafx.h"
@@ -0,0 +1,16 @@
+// stdafx.h: include file for standard system include files
+// Benchmark uses only non-UI classes of MFC (CString, CTime, CFile),
+// so sources from SimpleSync\sync are built against this header
+#pragma once
+
+#ifndef VC_EXTRALEAN
+#define VC_EXTRALEAN
+#endif
+
+#include "..\SimpleSync\targetver.h"
+
+#define _ATL_CSTRING_EXPLICIT_CONSTRUCTORS
+
+#include <afx.h>
+#include <tchar.h>
+#include <stdio.h>
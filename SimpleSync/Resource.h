@@ -108,6 +108,12 @@
 #define IDC_HELP_BUTTON                 1094
 #define IDC_SCAN_PROGRESS               1095
 #define IDC_SCAN_STATUS_STATIC          1096
+#define IDC_WATCH_CHECK                 1097
+#define IDC_NO_PREVIEW_CHECK            1098
+#define IDC_CONTENT_PARAMETER_CHECK     1099
+#define IDC_BYTES_PARAMETER_CHECK       1100
+#define IDC_TIME_TOLERANCE_STATIC       1101
+#define IDC_TIME_TOLERANCE_EDIT         1102
 
 // Next default values for new objects
 // 
@@ -115,7 +121,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        185
 #define _APS_NEXT_COMMAND_VALUE         32771
-#define _APS_NEXT_CONTROL_VALUE         1097
+#define _APS_NEXT_CONTROL_VALUE         1103
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
@@ -40,6 +40,7 @@ void CMainDialog::DoDataExchange(CDataExchange* pDX)
 BEGIN_MESSAGE_MAP(CMainDialog, CDialogEx)
 	ON_WM_PAINT()
 	ON_WM_QUERYDRAGICON()
+    ON_WM_DESTROY()
     ON_EN_CHANGE(IDC_SOURCE_PATH_BROWSE, &CMainDialog::OnSourceFolderChange)
     ON_EN_CHANGE(IDC_DESTINATION_FOLDER_BROWSE, &CMainDialog::OnDestinationFolderChange)
     ON_CONTROL_RANGE(BN_CLICKED,
@@ -51,6 +52,8 @@ BEGIN_MESSAGE_MAP(CMainDialog, CDialogEx)
     ON_BN_CLICKED(IDC_OPTIONS_BUTTON, &CMainDialog::OnOptionsButtonClicked)
     ON_BN_CLICKED(IDC_PARAMETERS_BUTTON, &CMainDialog::OnParametersButtonClicked)
     ON_BN_CLICKED(IDC_HELP_BUTTON, &CMainDialog::OnHelpButtonClicked)
+    ON_BN_CLICKED(IDC_WATCH_CHECK, &CMainDialog::OnWatchCheckClicked)
+    ON_MESSAGE(WM_WATCH_SYNC_COMPLETED, &CMainDialog::OnWatchSyncCompleted)
 END_MESSAGE_MAP()
 
 
@@ -110,6 +113,14 @@ HCURSOR CMainDialog::OnQueryDragIcon()
 	return static_cast<HCURSOR>(m_hIcon);
 }
 
+void CMainDialog::OnDestroy()
+{
+    // Watcher threads post messages to this window
+    m_syncManager->stopWatching();
+
+    CDialogEx::OnDestroy();
+}
+
 
 
 void CMainDialog::OnSourceFolderChange()
@@ -136,6 +147,15 @@ void CMainDialog::OnPreviewButtonClicked()
 
 void CMainDialog::OnSyncButtonClicked()
 {
+    if (m_syncManager->getOptions().syncWithoutPreview)
+    {
+        CSyncProgressDialog dialog(m_syncManager, TRUE);
+        dialog.DoModal();
+
+        m_previewList.clearPreview();
+        return;
+    }
+
     SyncManager::OperationQueue operations = m_syncManager->getOperationQueue();
     int operationsCount = operations.size();
 
@@ -203,3 +223,67 @@ void CMainDialog::OnHelpButtonClicked()
     LPWSTR title = _T("");
     MessageBox(msg, title, MB_ICONINFORMATION | MB_OK);
 }
+
+
+
+void CMainDialog::OnWatchCheckClicked()
+{
+    auto watchCheck = (CButton*)GetDlgItem(IDC_WATCH_CHECK);
+
+    if (watchCheck->GetCheck() != BST_CHECKED)
+    {
+        m_syncManager->stopWatching();
+        enableSyncControls(TRUE);
+        SetWindowText(_T("SimpleSync"));
+        return;
+    }
+
+    HWND dialogWindow = GetSafeHwnd();
+    SyncManager::WatchCallback callback = [dialogWindow](const SyncManager::OperationQueue& operations) {
+        ::PostMessage(dialogWindow, WM_WATCH_SYNC_COMPLETED, (WPARAM)operations.size(), 0);
+    };
+
+    if (!m_syncManager->startWatching(callback))
+    {
+        watchCheck->SetCheck(BST_UNCHECKED);
+        MessageBox(_T("     !"),
+                   _T(""), MB_ICONERROR | MB_OK);
+        return;
+    }
+
+    m_previewList.clearPreview();
+    enableSyncControls(FALSE);
+    SetWindowText(_T("SimpleSync - "));
+}
+
+LRESULT CMainDialog::OnWatchSyncCompleted(WPARAM wParam, LPARAM lParam)
+{
+    if (!m_syncManager->isWatching())
+        return 0;
+
+    CString title;
+    title.Format(_T("SimpleSync -  (%s:  %u)"),
+                 CTime::GetCurrentTime().Format(_T("%H:%M:%S")),
+                 (UINT)wParam);
+    SetWindowText(title);
+
+    return 0;
+}
+
+void CMainDialog::enableSyncControls(BOOL enable)
+{
+    const UINT controls[] = {
+        IDC_SOURCE_PATH_BROWSE,
+        IDC_DESTINATION_FOLDER_BROWSE,
+        IDC_PREVIEW_BUTTON,
+        IDC_SYNC_BUTTON,
+        IDC_DIRECTION_TO_RIGHT_BUTTON,
+        IDC_DIRECTION_BOTH_BUTTON,
+        IDC_DIRECTION_TO_LEFT_BUTTON,
+        IDC_OPTIONS_BUTTON,
+        IDC_PARAMETERS_BUTTON
+    };
+
+    for (UINT control : controls)
+        GetDlgItem(control)->EnableWindow(enable);
+}
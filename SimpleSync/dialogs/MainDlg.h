@@ -1,6 +1,8 @@
 #pragma once
 #include "controls/PreviewListCtrl.h"
 
+#define WM_WATCH_SYNC_COMPLETED (WM_USER + 300)
+
 class SyncManager;
 
 
@@ -23,6 +25,7 @@ protected:
 	virtual BOOL OnInitDialog();
 	afx_msg void OnPaint();
 	afx_msg HCURSOR OnQueryDragIcon();
+	afx_msg void OnDestroy();
 
 	DECLARE_MESSAGE_MAP()
 
@@ -40,6 +43,9 @@ private:
 
     CPngImage m_helpImage;
 
+    // Disables controls, that must not change while folders are watched
+    void enableSyncControls(BOOL enable);
+
 public:
     afx_msg void OnSourceFolderChange();
     afx_msg void OnDestinationFolderChange();
@@ -52,4 +58,7 @@ public:
 
     afx_msg void OnOptionsButtonClicked();
     afx_msg void OnParametersButtonClicked();
+
+    afx_msg void OnWatchCheckClicked();
+    afx_msg LRESULT OnWatchSyncCompleted(WPARAM wParam, LPARAM lParam);
 };
@@ -18,6 +18,7 @@ CSyncOptionsDialog::CSyncOptionsDialog(const SyncManager* syncManager,
     m_copyMissingFilesOption = m_syncOptions.copyMissingFiles;
     m_syncHiddenFilesOption = m_syncOptions.syncHiddenFiles;
     m_createEmptyFoldersOption = m_syncOptions.createEmptyFolders;
+    m_syncWithoutPreviewOption = m_syncOptions.syncWithoutPreview;
 }
 
 CSyncOptionsDialog::~CSyncOptionsDialog()
@@ -39,6 +40,7 @@ void CSyncOptionsDialog::DoDataExchange(CDataExchange* pDX)
     DDX_Check(pDX, IDC_COPY_MISSING_CHECK, m_copyMissingFilesOption);
     DDX_Check(pDX, IDC_HIDDEN_FILES_CHECK, m_syncHiddenFilesOption);
     DDX_Check(pDX, IDC_EMPTY_FOLDERS_CHECK, m_createEmptyFoldersOption);
+    DDX_Check(pDX, IDC_NO_PREVIEW_CHECK, m_syncWithoutPreviewOption);
 }
 
 
@@ -47,6 +49,10 @@ BEGIN_MESSAGE_MAP(CSyncOptionsDialog, CDialogEx)
                      IDC_RECURSIVE_CHECK,
                      IDC_EMPTY_FOLDERS_CHECK,
                      &CSyncOptionsDialog::OnOptionClicked)
+    ON_CONTROL_RANGE(BN_CLICKED,
+                     IDC_NO_PREVIEW_CHECK,
+                     IDC_NO_PREVIEW_CHECK,
+                     &CSyncOptionsDialog::OnOptionClicked)
 END_MESSAGE_MAP()
 
 
@@ -71,5 +77,8 @@ void CSyncOptionsDialog::OnOptionClicked(UINT id)
     case IDC_EMPTY_FOLDERS_CHECK:
         m_syncOptions.createEmptyFolders = m_createEmptyFoldersOption;
         break;
+    case IDC_NO_PREVIEW_CHECK:
+        m_syncOptions.syncWithoutPreview = m_syncWithoutPreviewOption;
+        break;
     }
 }
@@ -31,6 +31,7 @@ private:
     BOOL m_copyMissingFilesOption;
     BOOL m_syncHiddenFilesOption;
     BOOL m_createEmptyFoldersOption;
+    BOOL m_syncWithoutPreviewOption;
 
     SyncManagerOptions m_syncOptions;
 };
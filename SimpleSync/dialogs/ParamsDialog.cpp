@@ -16,7 +16,10 @@ CCompParametersDialog::CCompParametersDialog(const SyncManager* syncManager,
 
     m_compareSize = defaultParameters.m_compareSize;
     m_compareTime = defaultParameters.m_compareTime;
+    m_compareContent = defaultParameters.m_compareContent;
+    m_compareBytes = defaultParameters.m_compareBytes;
     m_timeParameterRadio = (int)defaultParameters.m_timeToCompare;
+    m_timeTolerance = defaultParameters.m_timeTolerance;
 }
 
 CCompParametersDialog::~CCompParametersDialog()
@@ -36,6 +39,9 @@ void CCompParametersDialog::DoDataExchange(CDataExchange* pDX)
     DDX_Radio(pDX, IDC_CREATION_TIME_RADIO, m_timeParameterRadio);
     DDX_Check(pDX, IDC_SIZE_PARAMETER_CHECK, m_compareSize);
     DDX_Check(pDX, IDC_TIME_PARAMETER_CHECK, m_compareTime);
+    DDX_Check(pDX, IDC_CONTENT_PARAMETER_CHECK, m_compareContent);
+    DDX_Check(pDX, IDC_BYTES_PARAMETER_CHECK, m_compareBytes);
+    DDX_Text(pDX, IDC_TIME_TOLERANCE_EDIT, m_timeTolerance);
 }
 
 void CCompParametersDialog::OnTimeRadioBoxClicked(UINT id)
@@ -73,10 +79,27 @@ void CCompParametersDialog::OnTimeCheckBoxClicked()
     enableTimeRadioBoxes(m_compareTime);
 }
 
+void CCompParametersDialog::OnContentCheckBoxClicked()
+{
+    UpdateData(TRUE);
+    m_parameters.m_compareContent = m_compareContent;
+
+    GetDlgItem(IDC_BYTES_PARAMETER_CHECK)->EnableWindow(m_compareContent);
+}
+
+void CCompParametersDialog::OnBytesCheckBoxClicked()
+{
+    UpdateData(TRUE);
+    m_parameters.m_compareBytes = m_compareBytes;
+}
+
 void CCompParametersDialog::enableTimeRadioBoxes(BOOL enable)
 {
     for (int i = IDC_CREATION_TIME_RADIO; i <= IDC_ACCESS_TIME_RADIO; ++i)
         GetDlgItem(i)->EnableWindow(enable);
+
+    GetDlgItem(IDC_TIME_TOLERANCE_STATIC)->EnableWindow(enable);
+    GetDlgItem(IDC_TIME_TOLERANCE_EDIT)->EnableWindow(enable);
 }
 
 BOOL CCompParametersDialog::OnInitDialog()
@@ -84,10 +107,22 @@ BOOL CCompParametersDialog::OnInitDialog()
     CDialogEx::OnInitDialog();
 
     enableTimeRadioBoxes(m_compareTime);
+    GetDlgItem(IDC_BYTES_PARAMETER_CHECK)->EnableWindow(m_compareContent);
 
     return TRUE;
 }
 
+void CCompParametersDialog::OnOK()
+{
+    // Tolerance is taken once, not on every keystroke
+    if (!UpdateData(TRUE))
+        return;
+
+    m_parameters.m_timeTolerance = m_timeTolerance;
+
+    CDialogEx::OnOK();
+}
+
 
 
 BEGIN_MESSAGE_MAP(CCompParametersDialog, CDialogEx)
@@ -99,4 +134,8 @@ BEGIN_MESSAGE_MAP(CCompParametersDialog, CDialogEx)
                   &CCompParametersDialog::OnSizeCheckBoxClicked)
     ON_BN_CLICKED(IDC_TIME_PARAMETER_CHECK,
                   &CCompParametersDialog::OnTimeCheckBoxClicked)
+    ON_BN_CLICKED(IDC_CONTENT_PARAMETER_CHECK,
+                  &CCompParametersDialog::OnContentCheckBoxClicked)
+    ON_BN_CLICKED(IDC_BYTES_PARAMETER_CHECK,
+                  &CCompParametersDialog::OnBytesCheckBoxClicked)
 END_MESSAGE_MAP()
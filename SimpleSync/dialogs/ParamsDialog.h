@@ -27,10 +27,13 @@ protected:
 
 public:
     virtual BOOL OnInitDialog();
+    virtual void OnOK();
 
     afx_msg void OnTimeRadioBoxClicked(UINT id);
     afx_msg void OnSizeCheckBoxClicked();
     afx_msg void OnTimeCheckBoxClicked();
+    afx_msg void OnContentCheckBoxClicked();
+    afx_msg void OnBytesCheckBoxClicked();
 
 private:
     void enableTimeRadioBoxes(BOOL enable);
@@ -39,5 +42,8 @@ private:
     
     BOOL m_compareSize;
     BOOL m_compareTime;
+    BOOL m_compareContent;
+    BOOL m_compareBytes;
     int m_timeParameterRadio;
+    UINT m_timeTolerance;
 };
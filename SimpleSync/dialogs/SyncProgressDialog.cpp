@@ -9,9 +9,12 @@
 IMPLEMENT_DYNAMIC(CSyncProgressDialog, CDialogEx)
 
 CSyncProgressDialog::CSyncProgressDialog(SyncManager* syncManager,
+                                         BOOL withoutPreview,
                                          CWnd* pParent)
 	: CDialogEx(IDD_SYNC_PROGRESS_DIALOG, pParent),
-      m_syncManager(syncManager)
+      m_syncManager(syncManager),
+      m_withoutPreview(withoutPreview),
+      m_syncResult(TRUE)
 {
 }
 
@@ -29,7 +32,10 @@ UINT CSyncProgressDialog::runSync(LPVOID pParam)
         dialog->showOperationProgress(op.get());
     };
 
-    dialog->m_syncManager->sync(&callback);
+    if (dialog->m_withoutPreview)
+        dialog->m_syncResult = dialog->m_syncManager->scanAndSync(NULL, &callback);
+    else
+        dialog->m_syncManager->sync(&callback);
 
     dialog->PostMessage(WM_SYNC_COMPLETED);
 
@@ -63,6 +69,9 @@ void CSyncProgressDialog::showOperationProgress(const SyncOperation* operation)
     case SyncOperation::TYPE::CREATE:
         title = _T(" %s");
         break;
+    case SyncOperation::TYPE::MOVE:
+        title = _T(" %s");
+        break;
     default:
         title = _T("...");
     }
@@ -72,7 +81,9 @@ void CSyncProgressDialog::showOperationProgress(const SyncOperation* operation)
 
     fullTitle->Format(title, filePath);
 
-    PostMessage(WM_SHOW_SYNC_PROGRESS, (WPARAM)fullTitle);
+    // Batch of small files counts as its operations
+    PostMessage(WM_SHOW_SYNC_PROGRESS, (WPARAM)fullTitle,
+                (LPARAM)operation->getOperationCount());
 }
 
 
@@ -80,6 +91,16 @@ BOOL CSyncProgressDialog::OnInitDialog()
 {
     CDialogEx::OnInitDialog();
 
+    if (m_withoutPreview)
+    {
+        // Number of operations is unknown until scan is over
+        m_syncProgressBar.ModifyStyle(0, PBS_MARQUEE);
+        m_syncProgressBar.SetMarquee(TRUE, 10);
+
+        AfxBeginThread(runSync, this);
+        return TRUE;
+    }
+
     SyncManager::OperationQueue operations = m_syncManager->getOperationQueue();
 
     auto notForbidden = [](SyncOperation::ptr& op) {
@@ -100,9 +121,24 @@ BOOL CSyncProgressDialog::OnInitDialog()
 
 LRESULT CSyncProgressDialog::OnSyncCompleted(WPARAM wParam, LPARAM lParam)
 {
+    if (m_withoutPreview)
+    {
+        m_syncProgressBar.SetMarquee(FALSE, 0);
+        m_syncProgressBar.ModifyStyle(PBS_MARQUEE, 0);
+        m_syncProgressBar.SetRange(0, 1);
+        m_syncProgressBar.SetPos(1);
+    }
+
     m_currentOperationTitle = CString(" ");
     UpdateData(FALSE);
 
+    if (!m_syncResult)
+    {
+        MessageBox(_T("  !\n"
+                      ",       ."),
+                   _T(""), MB_ICONERROR | MB_OK);
+    }
+
     auto okButton = (CButton *)GetDlgItem(IDOK);
     okButton->EnableWindow(TRUE);
 
@@ -111,7 +147,7 @@ LRESULT CSyncProgressDialog::OnSyncCompleted(WPARAM wParam, LPARAM lParam)
 
 LRESULT CSyncProgressDialog::OnShowSyncProgress(WPARAM wParam, LPARAM lParam)
 {
-    m_syncProgressBar.StepIt();
+    m_syncProgressBar.OffsetPos((int)lParam);
 
     m_currentOperationTitle = *((CString *)wParam);
     UpdateData(FALSE);
@@ -15,7 +15,11 @@ class CSyncProgressDialog : public CDialogEx
 	DECLARE_DYNAMIC(CSyncProgressDialog)
 
 public:
-	CSyncProgressDialog(SyncManager* syncManager, CWnd* pParent = NULL);
+	// withoutPreview - folders are scanned and synchronized at once,
+	// see SyncManager::scanAndSync()
+	CSyncProgressDialog(SyncManager* syncManager,
+	                    BOOL withoutPreview = FALSE,
+	                    CWnd* pParent = NULL);
 	virtual ~CSyncProgressDialog();
 
     // Run in separate worker thread
@@ -35,6 +39,9 @@ private:
     void showOperationProgress(const SyncOperation* operation);
 
     SyncManager* m_syncManager;
+    BOOL m_withoutPreview;
+    BOOL m_syncResult;
+
     CString m_currentOperationTitle;
     CProgressCtrl m_syncProgressBar;
 
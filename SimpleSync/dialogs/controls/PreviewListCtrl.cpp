@@ -122,6 +122,9 @@ void CPreviewListControl::printSyncOperation(SyncOperation* op,
     case TYPE::EMPTY:
         printEmptyOperation(dynamic_cast<EmptyOperation *>(op), index);
         break;
+    case TYPE::MOVE:
+        printMoveOperation(dynamic_cast<MoveOperation *>(op), index);
+        break;
     }
 }
 
@@ -303,6 +306,37 @@ void CPreviewListControl::printCreateOperation(CreateFolderOperation* operation,
     printOperationIcon(icon, index);
 }
 
+void CPreviewListControl::printMoveOperation(MoveOperation* operation,
+                                          int index)
+{
+    ICON icon;
+
+    FileProperties originalFile = operation->getFile();
+    FileProperties fileToMove = operation->getFileToMove();
+    LIST_COLUMN originalFileColumn;
+    LIST_COLUMN movedFileColumn;
+
+    if (m_syncManager->isFileInSourceFolder(originalFile))
+    {
+        originalFileColumn = LIST_COLUMN::SOURCE_FILE;
+        movedFileColumn = LIST_COLUMN::DESTINATION_FILE;
+        icon = ICON::RIGHT_ARROW;
+    }
+    else
+    {
+        originalFileColumn = LIST_COLUMN::DESTINATION_FILE;
+        movedFileColumn = LIST_COLUMN::SOURCE_FILE;
+        icon = ICON::LEFT_ARROW;
+    }
+
+    // Paths instead of names, as file changes folder or name
+    SetItemText(index, originalFileColumn,
+                m_syncManager->getFileRelativePath(originalFile, TRUE));
+    SetItemText(index, movedFileColumn,
+                m_syncManager->getFileRelativePath(fileToMove, TRUE));
+    printOperationIcon(icon, index);
+}
+
 
 
 int CPreviewListControl::forbidOperation(int index)
@@ -425,7 +459,7 @@ BOOL CPreviewListControl::showFilesComparisonDialog(const SyncOperation* twoFile
 
     FileProperties secondFile;
     
-    if (type == TYPE::REPLACE || type == TYPE::EMPTY)
+    if (type == TYPE::REPLACE || type == TYPE::EMPTY || type == TYPE::MOVE)
     {
         if (type == TYPE::REPLACE)
         {
@@ -433,6 +467,12 @@ BOOL CPreviewListControl::showFilesComparisonDialog(const SyncOperation* twoFile
             secondFile = op->getFileToReplace();
         }
 
+        if (type == TYPE::MOVE)
+        {
+            auto op = dynamic_cast<const MoveOperation*>(twoFilesOperation);
+            secondFile = op->getFileToMove();
+        }
+
         if (type == TYPE::EMPTY)
         {
             auto op = dynamic_cast<const EmptyOperation*>(twoFilesOperation);
@@ -545,7 +585,8 @@ COLORREF CPreviewListControl::chooseOperationTextColor(const SyncOperation* oper
     if (type == TYPE::REMOVE)
         return m_colors.REMOVE_TEXT_COLOR;
 
-    if (type == TYPE::COPY || type == TYPE::CREATE || type == TYPE::REPLACE)
+    if (type == TYPE::COPY || type == TYPE::CREATE ||
+        type == TYPE::REPLACE || type == TYPE::MOVE)
     {
         COLORREF color;
         FileProperties file = operation->getFile();
@@ -70,6 +70,7 @@ private:
     void printReplaceOperation(ReplaceOperation* operation, int index);
     void printEmptyOperation(EmptyOperation* operation, int index);
     void printCreateOperation(CreateFolderOperation* operation, int index);
+    void printMoveOperation(MoveOperation* operation, int index);
 
     // Used to recursively forbid dependent operations
     int forbidOperation(int index);
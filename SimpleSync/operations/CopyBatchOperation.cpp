@@ -0,0 +1,88 @@
+#include "stdafx.h"
+#include "CopyBatchOperation.h"
+#include "sync\FileCopy.h"
+
+
+
+CopyBatchOperation::CopyBatchOperation(const CopyPtr& firstCopy)
+    : SyncOperation(SyncOperation::TYPE::COPY, firstCopy->getFile())
+{
+    m_copies.push_back(firstCopy);
+}
+
+CopyBatchOperation::~CopyBatchOperation()
+{
+}
+
+
+
+BOOL CopyBatchOperation::canBatch(const SyncOperation* operation)
+{
+    if (operation->getType() != SyncOperation::TYPE::COPY || operation->isForbidden())
+        return FALSE;
+
+    FileProperties file = operation->getFile();
+    return !file.isFolder() && file.getSize() <= MAX_FILE_SIZE;
+}
+
+BOOL CopyBatchOperation::addCopy(const CopyPtr& copy)
+{
+    if (m_copies.size() >= MAX_COPIES)
+        return FALSE;
+
+    m_copies.push_back(copy);
+    return TRUE;
+}
+
+BOOL CopyBatchOperation::execute()
+{
+    // Every file fits into the buffer, unless it has grown since scan
+    std::vector<BYTE> buffer((size_t)MAX_FILE_SIZE);
+    BOOL result = TRUE;
+
+    for (const CopyPtr& copy : m_copies)
+    {
+        BOOL copied = FileCopy::copySmallFile(copy->getFile().getFullPath(),
+                                              copy->getCreatedPath(),
+                                              buffer,
+                                              getByteLimit());
+        result = result && copied;
+    }
+
+    return result;
+}
+
+BOOL CopyBatchOperation::affectsFile(const FileProperties& file) const
+{
+    for (const CopyPtr& copy : m_copies)
+    {
+        if (copy->affectsFile(file))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+BOOL CopyBatchOperation::dependsOn(const SyncOperation* operation) const
+{
+    for (const CopyPtr& copy : m_copies)
+    {
+        if (copy->dependsOn(operation))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+CString CopyBatchOperation::getCreatedPath() const
+{
+    return m_copies.front()->getCreatedPath();
+}
+
+size_t CopyBatchOperation::getOperationCount() const
+{
+    return m_copies.size();
+}
+
+CString CopyBatchOperation::getDestinationFolder() const
+{
+    return m_copies.front()->getDestinationFolder();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "CopyOperation.h"
+
+
+
+// Copies of small files into the same folder, executed at once:
+// files share one buffer and are reported as one operation
+// Made by CopyBatcher right before execution, so it never appears
+// in operation queue
+class CopyBatchOperation : public SyncOperation
+{
+public:
+    using CopyPtr = std::shared_ptr <CopyOperation>;
+
+    // Files of at most this size are batched
+    static const ULONGLONG MAX_FILE_SIZE = 64 * 1024;
+    static const size_t MAX_COPIES = 256;
+
+    CopyBatchOperation(const CopyPtr& firstCopy);
+    ~CopyBatchOperation();
+
+    // Copy of a small file, that is not forbidden
+    static BOOL canBatch(const SyncOperation* operation);
+
+    // Copy must go to the same folder; returns FALSE if batch is full
+    BOOL addCopy(const CopyPtr& copy);
+
+    BOOL affectsFile(const FileProperties& file) const override;
+    BOOL dependsOn(const SyncOperation* operation) const override;
+
+    // Path of the first file, so that batch waits for creation of its folder
+    CString getCreatedPath() const override;
+
+    size_t getOperationCount() const override;
+
+    CString getDestinationFolder() const;
+
+private:
+    BOOL execute() override;
+
+    std::vector <CopyPtr> m_copies;
+};
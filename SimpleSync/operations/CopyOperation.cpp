@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "CopyOperation.h"
+#include "sync\FileCopy.h"
 
 
 
@@ -16,16 +17,15 @@ CopyOperation::~CopyOperation()
 
 
 
-// Tip: Win32 functions GetFileAttributes() and SetFileAttributes() may be required
-//      to create identical copy of original file, as CopyFile() does not
-//      preserve "creation" and "last access" time stamps
+// FileCopy keeps all times and attributes of original file
 BOOL CopyOperation::execute()
 {
     CString originalFileName = getFile().getFileName();
     CString slash("\\");
 
     CString newFilePath = getDestinationFolder() + slash + originalFileName;
-    return CopyFile(getFile().getFullPath(), newFilePath, TRUE);
+    return FileCopy::copyFile(getFile().getFullPath(), newFilePath, FALSE,
+                              getByteLimit());
 }
 
 BOOL CopyOperation::affectsFile(const FileProperties& file) const
@@ -39,6 +39,11 @@ BOOL CopyOperation::dependsOn(const SyncOperation * operation) const
     return affectsFileToCopy;
 }
 
+CString CopyOperation::getCreatedPath() const
+{
+    return getDestinationFolder() + _T("\\") + getFile().getFileName();
+}
+
 CString CopyOperation::getDestinationFolder() const
 {
     return m_destinationFolder;
@@ -14,6 +14,8 @@ public:
     BOOL affectsFile(const FileProperties& file) const override;
     BOOL dependsOn(const SyncOperation* operation) const override;
 
+    CString getCreatedPath() const override;
+
     CString getDestinationFolder() const;
 
 private:
@@ -18,8 +18,14 @@ CreateFolderOperation::~CreateFolderOperation()
 
 BOOL CreateFolderOperation::execute()
 {
+    // Created folder takes attributes of original one,
+    // unless original cannot be opened anymore
     CString fullPathToFolder = getFolderToCreate().getFullPath();
-    return CreateDirectory(fullPathToFolder, NULL);
+    if (CreateDirectoryEx(getFile().getFullPath(), fullPathToFolder, NULL))
+        return TRUE;
+
+    return GetLastError() != ERROR_ALREADY_EXISTS &&
+           CreateDirectory(fullPathToFolder, NULL);
 }
 
 BOOL CreateFolderOperation::affectsFile(const FileProperties& file) const
@@ -44,7 +50,39 @@ BOOL CreateFolderOperation::dependsOn(const SyncOperation* operation) const
     return affectsOriginalFolder || affectsCreatedFolder;
 }
 
+CString CreateFolderOperation::getCreatedPath() const
+{
+    return getFolderToCreate().getFullPath();
+}
+
 FileProperties CreateFolderOperation::getFolderToCreate() const
 {
     return m_folderToCreate;
 }
+
+BOOL CreateFolderOperation::restoreTimes() const
+{
+    HANDLE folder = CreateFile(getFolderToCreate().getFullPath(),
+                               FILE_WRITE_ATTRIBUTES,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL,
+                               OPEN_EXISTING,
+                               FILE_FLAG_BACKUP_SEMANTICS,
+                               NULL);
+    if (folder == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    // Times come from scan; zero times are left as they are
+    FileProperties originalFolder = getFile();
+
+    FILE_BASIC_INFO basicInfo = {};
+    basicInfo.CreationTime.QuadPart = (LONGLONG)originalFolder.getCreationFileTime();
+    basicInfo.LastAccessTime.QuadPart = (LONGLONG)originalFolder.getLastAccessFileTime();
+    basicInfo.LastWriteTime.QuadPart = (LONGLONG)originalFolder.getLastWriteFileTime();
+
+    BOOL restored = SetFileInformationByHandle(folder, FileBasicInfo,
+                                               &basicInfo, sizeof(basicInfo));
+    CloseHandle(folder);
+
+    return restored;
+}
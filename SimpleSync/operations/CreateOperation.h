@@ -14,8 +14,14 @@ public:
     BOOL affectsFile(const FileProperties& file) const override;
     BOOL dependsOn(const SyncOperation* operation) const override;
 
+    CString getCreatedPath() const override;
+
     FileProperties getFolderToCreate() const;
 
+    // Gives created folder times of original one; called once everything
+    // inside it is written, as adding entries changes folder write time
+    BOOL restoreTimes() const;
+
 private:
     BOOL execute() override;
 
@@ -0,0 +1,63 @@
+#include "stdafx.h"
+#include "MoveOperation.h"
+
+
+
+MoveOperation::MoveOperation(const FileProperties& originalFile,
+                             const FileProperties& fileToMove,
+                             const CString& destinationFolder)
+    : SyncOperation(SyncOperation::TYPE::MOVE, originalFile),
+      m_fileToMove(fileToMove),
+      m_destinationFolder(destinationFolder)
+{
+}
+
+MoveOperation::~MoveOperation()
+{
+}
+
+
+
+BOOL MoveOperation::execute()
+{
+    // Destination folder exists: move follows its creation,
+    // see MoveDetector and getCreatedPath()
+    return MoveFileEx(getFileToMove().getFullPath(), getCreatedPath(),
+                      MOVEFILE_COPY_ALLOWED);
+}
+
+BOOL MoveOperation::affectsFile(const FileProperties& file) const
+{
+    BOOL equalToOriginalFile = file == getFile();
+    BOOL equalToMovedFile = file == getFileToMove();
+
+    return equalToOriginalFile || equalToMovedFile;
+}
+
+BOOL MoveOperation::dependsOn(const SyncOperation* operation) const
+{
+    BOOL affectsOriginalFile = operation->affectsFile(getFile());
+    BOOL affectsMovedFile = operation->affectsFile(getFileToMove());
+
+    return affectsOriginalFile || affectsMovedFile;
+}
+
+CString MoveOperation::getCreatedPath() const
+{
+    return getDestinationFolder() + _T("\\") + getFile().getFileName();
+}
+
+CString MoveOperation::getRemovedPath() const
+{
+    return getFileToMove().getFullPath();
+}
+
+FileProperties MoveOperation::getFileToMove() const
+{
+    return m_fileToMove;
+}
+
+CString MoveOperation::getDestinationFolder() const
+{
+    return m_destinationFolder;
+}
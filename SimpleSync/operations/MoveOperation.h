@@ -0,0 +1,33 @@
+#pragma once
+
+#include "SyncOperation.h"
+
+
+
+// File of destination, that would be removed, is renamed into the place,
+// where a file with the same content would be copied, so that moved or
+// renamed files are not copied again; made by MoveDetector after scan
+class MoveOperation : public SyncOperation
+{
+public:
+    MoveOperation(const FileProperties& originalFile,
+                  const FileProperties& fileToMove,
+                  const CString& destinationFolder);
+    ~MoveOperation();
+
+    BOOL affectsFile(const FileProperties& file) const override;
+    BOOL dependsOn(const SyncOperation* operation) const override;
+
+    CString getCreatedPath() const override;
+    CString getRemovedPath() const override;
+
+    FileProperties getFileToMove() const;
+    CString getDestinationFolder() const;
+
+private:
+    // Rename within a volume; across volumes file is copied and removed
+    BOOL execute() override;
+
+    FileProperties m_fileToMove;
+    CString m_destinationFolder;
+};
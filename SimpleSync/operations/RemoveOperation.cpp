@@ -43,3 +43,8 @@ BOOL RemoveOperation::dependsOn(const SyncOperation* operation) const
     FileProperties fileToRemove = getFile();
     return operation->affectsFile(fileToRemove);
 }
+
+CString RemoveOperation::getRemovedPath() const
+{
+    return getFile().getFullPath();
+}
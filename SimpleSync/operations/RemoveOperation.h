@@ -13,6 +13,8 @@ public:
     BOOL affectsFile(const FileProperties& file) const override;
     BOOL dependsOn(const SyncOperation* operation) const override;
 
+    CString getRemovedPath() const override;
+
 private:
     // Both files and folders can be removed
     // Only empty folders will be removed successfully
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "ReplaceOperation.h"
+#include "sync\FileCopy.h"
 
 
 
@@ -8,7 +9,9 @@ ReplaceOperation::ReplaceOperation(const FileProperties& file,
                                    BOOL isAmbiguous)
     : SyncOperation(SyncOperation::TYPE::REPLACE, file),
       m_fileToReplace(fileToReplace),
-      m_isAmbiguous(isAmbiguous)
+      m_isAmbiguous(isAmbiguous),
+      m_deltaThreshold(0),
+      m_isDeltaCopied(FALSE)
 {
 }
 
@@ -18,9 +21,7 @@ ReplaceOperation::~ReplaceOperation()
 
 
 
-// Tip: Win32 functions GetFileAttributes() and SetFileAttributes()
-//      may be required to create identical copy of original file,
-//      as CopyFile() does not preserve "creation" and "last access" time stamps
+// Both DeltaCopy and FileCopy keep all times and attributes of original file
 BOOL ReplaceOperation::execute()
 {
     if (isAmbiguous())
@@ -29,7 +30,20 @@ BOOL ReplaceOperation::execute()
     {
         CString orignalFile = getFile().getFullPath();
         CString fileToReplace = getFileToReplace().getFullPath();
-        return CopyFile(orignalFile, fileToReplace, FALSE);
+
+        if (usesDelta())
+        {
+            // File that cannot be changed in place is copied whole
+            DeltaCopy::Result result;
+            if (DeltaCopy::copyFile(orignalFile, fileToReplace, result, getByteLimit()))
+            {
+                m_deltaResult = result;
+                m_isDeltaCopied = TRUE;
+                return TRUE;
+            }
+        }
+
+        return FileCopy::copyFile(orignalFile, fileToReplace, TRUE, getByteLimit());
     }
         
 }
@@ -64,3 +78,25 @@ void ReplaceOperation::removeAmbiguity()
 {
     m_isAmbiguous = FALSE;
 }
+
+void ReplaceOperation::setDeltaThreshold(ULONGLONG threshold)
+{
+    m_deltaThreshold = threshold;
+}
+
+DeltaCopy::Result ReplaceOperation::getDeltaResult() const
+{
+    return m_deltaResult;
+}
+
+BOOL ReplaceOperation::isDeltaCopied() const
+{
+    return m_isDeltaCopied;
+}
+
+
+
+BOOL ReplaceOperation::usesDelta() const
+{
+    return m_deltaThreshold != 0 && getFile().getSize() >= m_deltaThreshold;
+}
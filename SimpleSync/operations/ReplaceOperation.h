@@ -1,6 +1,7 @@
 #pragma once
 
 #include "SyncOperation.h"
+#include "sync\DeltaCopy.h"
 
 
 
@@ -24,10 +25,24 @@ public:
     
     void removeAmbiguity();
 
+    // Files of at least this size are replaced with DeltaCopy,
+    // only changed blocks are written; 0 - whole file is always copied
+    void setDeltaThreshold(ULONGLONG threshold);
+
+    // Result of execution with DeltaCopy, empty if file was copied whole
+    DeltaCopy::Result getDeltaResult() const;
+    BOOL isDeltaCopied() const;
+
 private:
     BOOL execute() override;
 
+    BOOL usesDelta() const;
+
     FileProperties m_fileToReplace;
     BOOL m_isAmbiguous;
+
+    ULONGLONG m_deltaThreshold;
+    DeltaCopy::Result m_deltaResult;
+    BOOL m_isDeltaCopied;
 };
 
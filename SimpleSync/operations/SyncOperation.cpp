@@ -4,7 +4,7 @@
 
 
 SyncOperation::SyncOperation(TYPE type, const FileProperties& file)
-    : m_type(type), m_file(file)
+    : m_type(type), m_byteLimit(NULL), m_file(file)
 {
     m_isForbidden = FALSE;
 }
@@ -25,6 +25,31 @@ BOOL SyncOperation::isForbidden() const
     return m_isForbidden;
 }
 
+CString SyncOperation::getCreatedPath() const
+{
+    return CString();
+}
+
+CString SyncOperation::getRemovedPath() const
+{
+    return CString();
+}
+
+size_t SyncOperation::getOperationCount() const
+{
+    return 1;
+}
+
+void SyncOperation::setByteLimit(TokenBucket* byteLimit)
+{
+    m_byteLimit = byteLimit;
+}
+
+TokenBucket* SyncOperation::getByteLimit() const
+{
+    return m_byteLimit;
+}
+
 SyncOperation::TYPE SyncOperation::getType() const
 {
     return m_type;
@@ -4,6 +4,8 @@
 #include "sync\FileProperties.h"
 #include <memory>
 
+class TokenBucket;
+
 
 
 class SyncOperation
@@ -23,7 +25,8 @@ public:
         REPLACE,
         REMOVE,
         CREATE,
-        EMPTY
+        EMPTY,
+        MOVE
     };
     
     SyncOperation(TYPE type, const FileProperties& file);
@@ -36,6 +39,22 @@ public:
     // Utilizes affectsFile()
     virtual BOOL dependsOn(const SyncOperation* operation) const = 0;
 
+    // Paths, that appear or disappear when operation is executed,
+    // used to order operations that run in parallel, see OperationExecutor
+    // Empty if operation neither creates nor removes anything
+    virtual CString getCreatedPath() const;
+    virtual CString getRemovedPath() const;
+
+    // Number of queued operations, that this one executes;
+    // more than one for batches, see CopyBatchOperation
+    virtual size_t getOperationCount() const;
+
+    // Limit of bandwidth, see SyncManagerOptions::bytesPerSecond;
+    // operations, that write file data, charge it for each block written
+    // May be NULL, then data is written at full speed
+    void setByteLimit(TokenBucket* byteLimit);
+    TokenBucket* getByteLimit() const;
+
     // Forbidden operations are ignored by SyncManager
     void forbid(BOOL isForbidden);
     BOOL isForbidden() const;
@@ -50,6 +69,7 @@ private:
 
     TYPE m_type;
     BOOL m_isForbidden;
+    TokenBucket* m_byteLimit;
 
     FileProperties m_file;
 };
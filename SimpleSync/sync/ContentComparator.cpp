@@ -0,0 +1,199 @@
+#include "stdafx.h"
+#include "ContentComparator.h"
+#include "ContentHash.h"
+#include "ContentCompare.h"
+#include <vector>
+
+
+
+static const DWORD SAMPLE_BLOCK_SIZE = 64 * 1024;
+static const DWORD SAMPLE_BLOCK_COUNT = 3;
+
+static const ULONGLONG FILETIME_TICKS_PER_MILLISECOND = 10000;
+
+
+ContentComparator::ContentComparator(const FileComparisonParameters& params,
+                                     HashCache* hashCache)
+    : m_params(params),
+      m_hashCache(hashCache),
+      m_metadataDecisions(0),
+      m_cacheDecisions(0),
+      m_sampleDecisions(0),
+      m_fullDecisions(0)
+{
+}
+
+
+
+BOOL ContentComparator::equalContent(const FileProperties& firstFile,
+                                     const FileProperties& secondFile)
+{
+    if (decidesByMetadata(firstFile, secondFile))
+    {
+        ++m_metadataDecisions;
+        return firstFile.getSize() == secondFile.getSize();
+    }
+
+    ULONGLONG firstHash = 0;
+    ULONGLONG secondHash = 0;
+    BOOL firstCached = FALSE;
+    BOOL secondCached = FALSE;
+
+    if (m_hashCache && !m_params.m_compareBytes)
+    {
+        firstCached = m_hashCache->findHash(firstFile, firstHash);
+        secondCached = m_hashCache->findHash(secondFile, secondHash);
+
+        if (firstCached && secondCached)
+        {
+            ++m_cacheDecisions;
+            return firstHash == secondHash;
+        }
+    }
+
+    // Small files are read completely by the full comparison anyway
+    ULONGLONG size = firstFile.getSize();
+    if (size > SAMPLE_BLOCK_SIZE * SAMPLE_BLOCK_COUNT)
+    {
+        ULONGLONG firstSample = 0;
+        ULONGLONG secondSample = 0;
+
+        BOOL sampled = sampleFile(firstFile.getFullPath(), size, firstSample) &&
+                       sampleFile(secondFile.getFullPath(), size, secondSample);
+
+        // Equal samples do not prove equal content, only different do
+        if (sampled && firstSample != secondSample)
+        {
+            ++m_sampleDecisions;
+            return FALSE;
+        }
+    }
+
+    ++m_fullDecisions;
+    return compareFull(firstFile, secondFile,
+                       firstCached, firstHash,
+                       secondCached, secondHash);
+}
+
+BOOL ContentComparator::decidesByMetadata(const FileProperties& firstFile,
+                                          const FileProperties& secondFile) const
+{
+    if (firstFile.getSize() != secondFile.getSize())
+        return TRUE;
+
+    // Byte-by-byte comparison is chosen not to trust anything but content
+    if (m_params.m_compareBytes)
+        return FALSE;
+
+    ULONGLONG firstTime = firstFile.getLastWriteFileTime();
+    ULONGLONG secondTime = secondFile.getLastWriteFileTime();
+    if (firstTime == 0 || secondTime == 0)
+        return FALSE;
+
+    ULONGLONG difference = (firstTime > secondTime) ? firstTime - secondTime
+                                                    : secondTime - firstTime;
+    return difference <= m_params.m_timeTolerance * FILETIME_TICKS_PER_MILLISECOND;
+}
+
+ULONGLONG ContentComparator::getMetadataDecisions() const
+{
+    return m_metadataDecisions;
+}
+
+ULONGLONG ContentComparator::getCacheDecisions() const
+{
+    return m_cacheDecisions;
+}
+
+ULONGLONG ContentComparator::getSampleDecisions() const
+{
+    return m_sampleDecisions;
+}
+
+ULONGLONG ContentComparator::getFullDecisions() const
+{
+    return m_fullDecisions;
+}
+
+
+
+BOOL ContentComparator::sampleFile(const CString& path,
+                                   ULONGLONG size,
+                                   ULONGLONG& sample)
+{
+    HANDLE file = CreateFile(path,
+                             GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             NULL,
+                             OPEN_EXISTING,
+                             FILE_FLAG_RANDOM_ACCESS,
+                             NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    ContentHash hash;
+    hash.update(&size, sizeof(size));
+
+    // File, that is not larger than all blocks together, is hashed whole
+    // as one block, so that block offsets cannot go below zero
+    BOOL isSmall = size <= (ULONGLONG)SAMPLE_BLOCK_SIZE * SAMPLE_BLOCK_COUNT;
+    DWORD blockSize = isSmall ? (DWORD)size : SAMPLE_BLOCK_SIZE;
+    size_t blockCount = isSmall ? 1 : SAMPLE_BLOCK_COUNT;
+
+    ULONGLONG offsets[SAMPLE_BLOCK_COUNT] = {
+        0,
+        isSmall ? 0 : (size - SAMPLE_BLOCK_SIZE) / 2,
+        isSmall ? 0 : size - SAMPLE_BLOCK_SIZE
+    };
+
+    std::vector<BYTE> buffer(blockSize);
+    BOOL result = TRUE;
+
+    for (size_t i = 0; i < blockCount && blockSize > 0; ++i)
+    {
+        // Offset of OVERLAPPED is used by synchronous handles too
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)offsets[i];
+        overlapped.OffsetHigh = (DWORD)(offsets[i] >> 32);
+
+        DWORD bytesRead = 0;
+        result = ReadFile(file, buffer.data(), blockSize,
+                          &bytesRead, &overlapped) &&
+                 bytesRead == blockSize;
+        if (!result)
+            break;
+
+        hash.update(buffer.data(), bytesRead);
+    }
+
+    CloseHandle(file);
+
+    sample = hash.digest();
+    return result;
+}
+
+BOOL ContentComparator::compareFull(const FileProperties& firstFile,
+                                    const FileProperties& secondFile,
+                                    BOOL firstCached, ULONGLONG firstHash,
+                                    BOOL secondCached, ULONGLONG secondHash)
+{
+    if (m_params.m_compareBytes)
+    {
+        BOOL equal = FALSE;
+        BOOL compared = ContentCompare::compareFiles(firstFile.getFullPath(),
+                                                     secondFile.getFullPath(),
+                                                     equal);
+        return compared && equal;
+    }
+
+    // Hash, already found in cache, is not looked up again
+    BOOL hashed;
+    if (m_hashCache)
+        hashed = (firstCached || m_hashCache->getHash(firstFile, firstHash)) &&
+                 (secondCached || m_hashCache->getHash(secondFile, secondHash));
+    else
+        hashed = ContentHash::hashFile(firstFile.getFullPath(), firstHash) &&
+                 ContentHash::hashFile(secondFile.getFullPath(), secondHash);
+
+    return hashed && firstHash == secondHash;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+
+#include "FileProperties.h"
+#include "HashCache.h"
+
+
+
+// Decides whether two files have the same content in tiers,
+// cheapest first, so that most pairs are decided without full reads:
+// 1. metadata: files of different size differ; files of the same size
+//    and write time (within time tolerance) are taken as equal,
+//    except byte-by-byte comparison
+// 2. hashes of both files are found in HashCache
+// 3. sample: first, middle and last blocks of files differ
+// 4. full comparison: content hashes or ContentCompare
+// Can be used from several threads at once
+class ContentComparator
+{
+public:
+    // hashCache may be NULL, then content is hashed every time
+    ContentComparator(const FileComparisonParameters& params,
+                      HashCache* hashCache);
+
+    ContentComparator(const ContentComparator&) = delete;
+    ContentComparator& operator= (const ContentComparator&) = delete;
+
+    // Files, whose content cannot be read, are not equal
+    BOOL equalContent(const FileProperties& firstFile,
+                      const FileProperties& secondFile);
+
+    // Metadata tier is enough, files do not have to be read
+    BOOL decidesByMetadata(const FileProperties& firstFile,
+                           const FileProperties& secondFile) const;
+
+    // Number of pairs decided by each tier
+    ULONGLONG getMetadataDecisions() const;
+    ULONGLONG getCacheDecisions() const;
+    ULONGLONG getSampleDecisions() const;
+    ULONGLONG getFullDecisions() const;
+
+    // XXH64 of file size and of sampled blocks;
+    // files of up to three blocks are hashed whole
+    static BOOL sampleFile(const CString& path, ULONGLONG size, ULONGLONG& sample);
+
+private:
+
+    BOOL compareFull(const FileProperties& firstFile,
+                     const FileProperties& secondFile,
+                     BOOL firstCached, ULONGLONG firstHash,
+                     BOOL secondCached, ULONGLONG secondHash);
+
+    const FileComparisonParameters m_params;
+    HashCache* m_hashCache;
+
+    std::atomic <ULONGLONG> m_metadataDecisions;
+    std::atomic <ULONGLONG> m_cacheDecisions;
+    std::atomic <ULONGLONG> m_sampleDecisions;
+    std::atomic <ULONGLONG> m_fullDecisions;
+};
@@ -0,0 +1,89 @@
+#include "stdafx.h"
+#include "ContentCompare.h"
+
+
+
+// Same block size as ContentHash reads with
+static const DWORD COMPARE_BLOCK_SIZE = 1024 * 1024;
+
+
+static HANDLE openForCompare(const CString& path)
+{
+    return CreateFile(path,
+                      GENERIC_READ,
+                      FILE_SHARE_READ | FILE_SHARE_WRITE,
+                      NULL,
+                      OPEN_EXISTING,
+                      FILE_FLAG_SEQUENTIAL_SCAN,
+                      NULL);
+}
+
+// Reads until buffer is full or file ends
+static BOOL readBlock(HANDLE file, BYTE* buffer, DWORD& bytesRead)
+{
+    bytesRead = 0;
+
+    while (bytesRead < COMPARE_BLOCK_SIZE)
+    {
+        DWORD chunk = 0;
+        if (!ReadFile(file, buffer + bytesRead, COMPARE_BLOCK_SIZE - bytesRead,
+                      &chunk, NULL))
+            return FALSE;
+
+        if (chunk == 0)
+            break;
+        bytesRead += chunk;
+    }
+
+    return TRUE;
+}
+
+
+
+BOOL ContentCompare::compareFiles(const CString& firstPath,
+                                  const CString& secondPath,
+                                  BOOL& equal)
+{
+    HANDLE firstFile = openForCompare(firstPath);
+    if (firstFile == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    HANDLE secondFile = openForCompare(secondPath);
+    if (secondFile == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(firstFile);
+        return FALSE;
+    }
+
+    // Page-aligned buffers, both blocks in one allocation
+    BYTE* buffers = (BYTE*)VirtualAlloc(NULL, 2 * COMPARE_BLOCK_SIZE,
+                                        MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    BOOL result = buffers != NULL;
+    equal = TRUE;
+
+    while (result && equal)
+    {
+        DWORD firstRead = 0;
+        DWORD secondRead = 0;
+
+        result = readBlock(firstFile, buffers, firstRead) &&
+                 readBlock(secondFile, buffers + COMPARE_BLOCK_SIZE, secondRead);
+        if (!result)
+            break;
+
+        // memcmp() of CRT is vectorized
+        equal = firstRead == secondRead &&
+                memcmp(buffers, buffers + COMPARE_BLOCK_SIZE, firstRead) == 0;
+
+        if (firstRead < COMPARE_BLOCK_SIZE)
+            break;
+    }
+
+    if (buffers)
+        VirtualFree(buffers, 0, MEM_RELEASE);
+
+    CloseHandle(firstFile);
+    CloseHandle(secondFile);
+
+    return result;
+}
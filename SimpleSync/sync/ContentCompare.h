@@ -0,0 +1,16 @@
+#pragma once
+
+
+
+// Byte-by-byte comparison of two files, for cases when equal hashes
+// are not enough
+// Files are read side by side in large blocks and reading stops
+// at the first block that differs
+class ContentCompare
+{
+public:
+    // Returns FALSE if either file cannot be read
+    static BOOL compareFiles(const CString& firstPath,
+                             const CString& secondPath,
+                             BOOL& equal);
+};
@@ -0,0 +1,190 @@
+#include "stdafx.h"
+#include "ContentHash.h"
+#include <vector>
+
+
+
+static const ULONGLONG PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const ULONGLONG PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const ULONGLONG PRIME64_3 = 0x165667B19E3779F9ULL;
+static const ULONGLONG PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const ULONGLONG PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+// Files are read by large blocks, so that disk works sequentially
+static const DWORD READ_BLOCK_SIZE = 1024 * 1024;
+
+
+static ULONGLONG rotateLeft(ULONGLONG value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Input is little-endian, as on every platform the application runs on
+static ULONGLONG read64(const BYTE* data)
+{
+    ULONGLONG value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static DWORD read32(const BYTE* data)
+{
+    DWORD value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+
+
+ContentHash::ContentHash(ULONGLONG seed)
+    : m_seed(seed),
+      m_totalSize(0),
+      m_bufferSize(0)
+{
+    m_accumulators[0] = seed + PRIME64_1 + PRIME64_2;
+    m_accumulators[1] = seed + PRIME64_2;
+    m_accumulators[2] = seed;
+    m_accumulators[3] = seed - PRIME64_1;
+}
+
+
+
+void ContentHash::update(const void* data, size_t size)
+{
+    const BYTE* position = (const BYTE*)data;
+    m_totalSize += size;
+
+    if (m_bufferSize > 0)
+    {
+        size_t toCopy = (std::min)(size, sizeof(m_buffer) - m_bufferSize);
+        memcpy(m_buffer + m_bufferSize, position, toCopy);
+
+        m_bufferSize += toCopy;
+        position += toCopy;
+        size -= toCopy;
+
+        if (m_bufferSize < sizeof(m_buffer))
+            return;
+
+        consumeStripe(m_buffer);
+        m_bufferSize = 0;
+    }
+
+    for (; size >= sizeof(m_buffer); size -= sizeof(m_buffer))
+    {
+        consumeStripe(position);
+        position += sizeof(m_buffer);
+    }
+
+    memcpy(m_buffer, position, size);
+    m_bufferSize = size;
+}
+
+ULONGLONG ContentHash::digest() const
+{
+    ULONGLONG hash;
+
+    if (m_totalSize >= sizeof(m_buffer))
+    {
+        hash = rotateLeft(m_accumulators[0], 1) + rotateLeft(m_accumulators[1], 7) +
+               rotateLeft(m_accumulators[2], 12) + rotateLeft(m_accumulators[3], 18);
+
+        for (ULONGLONG accumulator : m_accumulators)
+            hash = mergeRound(hash, accumulator);
+    }
+    else
+        hash = m_seed + PRIME64_5;
+
+    hash += m_totalSize;
+
+    const BYTE* position = m_buffer;
+    size_t size = m_bufferSize;
+
+    for (; size >= 8; size -= 8, position += 8)
+    {
+        hash ^= round(0, read64(position));
+        hash = rotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+    }
+
+    if (size >= 4)
+    {
+        hash ^= (ULONGLONG)read32(position) * PRIME64_1;
+        hash = rotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+        size -= 4;
+        position += 4;
+    }
+
+    for (; size > 0; --size, ++position)
+    {
+        hash ^= (*position) * PRIME64_5;
+        hash = rotateLeft(hash, 11) * PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+BOOL ContentHash::hashFile(const CString& path, ULONGLONG& hash)
+{
+    HANDLE file = CreateFile(path,
+                             GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             NULL,
+                             OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN,
+                             NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    std::vector<BYTE> block(READ_BLOCK_SIZE);
+    ContentHash content;
+
+    BOOL result = TRUE;
+    for (;;)
+    {
+        DWORD bytesRead = 0;
+        if (!ReadFile(file, block.data(), READ_BLOCK_SIZE, &bytesRead, NULL))
+        {
+            result = FALSE;
+            break;
+        }
+
+        if (bytesRead == 0)
+            break;
+
+        content.update(block.data(), bytesRead);
+    }
+
+    CloseHandle(file);
+
+    if (result)
+        hash = content.digest();
+
+    return result;
+}
+
+
+
+ULONGLONG ContentHash::round(ULONGLONG accumulator, ULONGLONG input)
+{
+    accumulator += input * PRIME64_2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * PRIME64_1;
+}
+
+ULONGLONG ContentHash::mergeRound(ULONGLONG accumulator, ULONGLONG value)
+{
+    accumulator ^= round(0, value);
+    return accumulator * PRIME64_1 + PRIME64_4;
+}
+
+void ContentHash::consumeStripe(const BYTE* stripe)
+{
+    for (int i = 0; i < 4; ++i)
+        m_accumulators[i] = round(m_accumulators[i], read64(stripe + i * 8));
+}
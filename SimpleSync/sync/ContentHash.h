@@ -0,0 +1,32 @@
+#pragma once
+
+
+
+// XXH64 hash of file content, used to compare files, whose times
+// or sizes do not tell whether they differ
+// Streaming state: update() may be called any number of times
+class ContentHash
+{
+public:
+    ContentHash(ULONGLONG seed = 0);
+
+    void update(const void* data, size_t size);
+    ULONGLONG digest() const;
+
+    // Reads whole file sequentially; returns FALSE if file cannot be read
+    static BOOL hashFile(const CString& path, ULONGLONG& hash);
+
+private:
+    static ULONGLONG round(ULONGLONG accumulator, ULONGLONG input);
+    static ULONGLONG mergeRound(ULONGLONG accumulator, ULONGLONG value);
+
+    void consumeStripe(const BYTE* stripe);
+
+    ULONGLONG m_seed;
+    ULONGLONG m_accumulators[4];
+    ULONGLONG m_totalSize;
+
+    // Bytes that do not fill a whole 32-byte stripe yet
+    BYTE m_buffer[32];
+    size_t m_bufferSize;
+};
@@ -0,0 +1,48 @@
+#include "stdafx.h"
+#include "CopyBatcher.h"
+
+
+
+CopyBatcher::CopyBatcher(const Output& output)
+    : m_output(output)
+{
+}
+
+CopyBatcher::~CopyBatcher()
+{
+}
+
+
+
+void CopyBatcher::add(const SyncOperation::ptr& operation)
+{
+    if (!operation || !CopyBatchOperation::canBatch(operation.get()))
+    {
+        flush();
+        m_output(operation);
+        return;
+    }
+
+    auto copy = std::static_pointer_cast<CopyOperation>(operation);
+
+    BOOL added = m_batch &&
+                 m_batch->getDestinationFolder() == copy->getDestinationFolder() &&
+                 m_batch->addCopy(copy);
+    if (added)
+        return;
+
+    flush();
+    m_batch = std::make_shared<CopyBatchOperation>(copy);
+}
+
+void CopyBatcher::flush()
+{
+    if (!m_batch)
+        return;
+
+    // Shared pointer is stored, as output may keep it
+    SyncOperation::ptr batch = m_batch;
+    m_batch.reset();
+
+    m_output(batch);
+}
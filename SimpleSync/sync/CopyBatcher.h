@@ -0,0 +1,29 @@
+#pragma once
+
+#include <functional>
+
+#include "operations/CopyBatchOperation.h"
+
+
+
+// Groups consecutive copies of small files into the same folder
+// into CopyBatchOperation, other operations are passed on as they are
+// Order of operations is kept
+class CopyBatcher
+{
+public:
+    using Output = std::function <void (const SyncOperation::ptr&)>;
+
+    CopyBatcher(const Output& output);
+    ~CopyBatcher();
+
+    void add(const SyncOperation::ptr& operation);
+
+    // Passes on the batch, that is being collected;
+    // must be called after the last operation is added
+    void flush();
+
+private:
+    Output m_output;
+    std::shared_ptr <CopyBatchOperation> m_batch;
+};
@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "DeltaCopy.h"
+#include "FileCopy.h"
+#include "TokenBucket.h"
+
+
+
+// Smaller blocks find more unchanged data, larger ones mean fewer calls
+static const DWORD DELTA_BLOCK_SIZE = 256 * 1024;
+
+
+// Reads block at offset; bytesRead is less than block size at end of file
+static BOOL readBlockAt(HANDLE file, ULONGLONG offset, BYTE* buffer, DWORD& bytesRead)
+{
+    // Offset of OVERLAPPED is used by synchronous handles too
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+    bytesRead = 0;
+    if (ReadFile(file, buffer, DELTA_BLOCK_SIZE, &bytesRead, &overlapped))
+        return TRUE;
+
+    return GetLastError() == ERROR_HANDLE_EOF;
+}
+
+static BOOL writeBlockAt(HANDLE file, ULONGLONG offset, const BYTE* buffer, DWORD size)
+{
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+    DWORD written = 0;
+    return WriteFile(file, buffer, size, &written, &overlapped) && written == size;
+}
+
+
+
+BOOL DeltaCopy::copyFile(const CString& sourcePath,
+                         const CString& destinationPath,
+                         Result& result,
+                         TokenBucket* byteLimit)
+{
+    HANDLE source = CreateFile(sourcePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (source == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    HANDLE destination = CreateFile(destinationPath, GENERIC_READ | GENERIC_WRITE,
+                                    0, NULL, OPEN_EXISTING,
+                                    FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (destination == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(source);
+        return FALSE;
+    }
+
+    // Page-aligned buffers, both blocks in one allocation
+    BYTE* buffers = (BYTE*)VirtualAlloc(NULL, 2 * DELTA_BLOCK_SIZE,
+                                        MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    BYTE* sourceBlock = buffers;
+    BYTE* destinationBlock = buffers + DELTA_BLOCK_SIZE;
+
+    BOOL copied = buffers != NULL;
+    ULONGLONG offset = 0;
+
+    while (copied)
+    {
+        DWORD sourceRead = 0;
+        DWORD destinationRead = 0;
+
+        copied = readBlockAt(source, offset, sourceBlock, sourceRead) &&
+                 readBlockAt(destination, offset, destinationBlock, destinationRead);
+        if (!copied || sourceRead == 0)
+            break;
+
+        BOOL equalBlocks = sourceRead == destinationRead &&
+                           memcmp(sourceBlock, destinationBlock, sourceRead) == 0;
+        if (equalBlocks)
+            result.bytesSkipped += sourceRead;
+        else
+        {
+            if (byteLimit)
+                byteLimit->acquire(sourceRead);
+
+            copied = writeBlockAt(destination, offset, sourceBlock, sourceRead);
+            result.bytesWritten += sourceRead;
+        }
+
+        offset += sourceRead;
+        if (sourceRead < DELTA_BLOCK_SIZE)
+            break;
+    }
+
+    if (copied)
+    {
+        // Destination may have been longer than source
+        LARGE_INTEGER size;
+        size.QuadPart = (LONGLONG)offset;
+        copied = SetFilePointerEx(destination, size, NULL, FILE_BEGIN) &&
+                 SetEndOfFile(destination);
+    }
+
+    if (copied)
+    {
+        // Same times and attributes, as FileCopy gives,
+        // so that files do not look different on the next scan
+        BY_HANDLE_FILE_INFORMATION sourceInfo;
+        copied = GetFileInformationByHandle(source, &sourceInfo) &&
+                 FileCopy::copyMetadata(destination, sourceInfo);
+    }
+
+    if (buffers)
+        VirtualFree(buffers, 0, MEM_RELEASE);
+
+    CloseHandle(source);
+    CloseHandle(destination);
+
+    return copied;
+}
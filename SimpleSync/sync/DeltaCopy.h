@@ -0,0 +1,29 @@
+#pragma once
+
+class TokenBucket;
+
+
+
+// Replaces content of existing file with content of another file,
+// rewriting only blocks that differ, so that small changes in large files
+// (disk images, databases) do not cause the whole file to be written
+// Both files are read side by side; destination is changed in place,
+// then cut to the size of source and given its times and attributes
+class DeltaCopy
+{
+public:
+    struct Result
+    {
+        ULONGLONG bytesWritten = 0;
+
+        // Bytes of blocks, that were equal and were not written
+        ULONGLONG bytesSkipped = 0;
+    };
+
+    // Returns FALSE if either file cannot be opened, read or written
+    // byteLimit, if given, is charged for each block before it is written
+    static BOOL copyFile(const CString& sourcePath,
+                         const CString& destinationPath,
+                         Result& result,
+                         TokenBucket* byteLimit = NULL);
+};
@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include "FileComparator.h"
+#include "ContentComparator.h"
+
+using COMPARISON = FileProperties::COMPARISON_RESULT;
+
+
+
+static const ULONGLONG FILETIME_TICKS_PER_MILLISECOND = 10000;
+
+
+FileComparator::FileComparator(const FileComparisonParameters& params)
+    : m_criteriaCount(0),
+      m_params(params)
+{
+    if (params.m_compareSize)
+        addCriterion(&compareBy<&FileProperties::getSize>, 0);
+
+    if (params.m_compareTime)
+    {
+        ULONGLONG tolerance = params.m_timeTolerance * FILETIME_TICKS_PER_MILLISECOND;
+
+        switch (params.m_timeToCompare)
+        {
+        case FileProperties::TIME_STAMP::CREATION_TIME:
+            addCriterion(&compareBy<&FileProperties::getCreationFileTime>, tolerance);
+            break;
+        case FileProperties::TIME_STAMP::LAST_ACCESS_TIME:
+            addCriterion(&compareBy<&FileProperties::getLastAccessFileTime>, tolerance);
+            break;
+        case FileProperties::TIME_STAMP::LAST_WRITE_TIME:
+            addCriterion(&compareBy<&FileProperties::getLastWriteFileTime>, tolerance);
+            break;
+        }
+    }
+}
+
+
+
+COMPARISON FileComparator::compare(const FileProperties& first,
+                                   const FileProperties& second,
+                                   ContentComparator* contentComparator) const
+{
+    BOOL equalNames = first.getFileName() == second.getFileName();
+    if (!equalNames)
+        return COMPARISON::UNDEFINED;
+
+    BOOL preferable = FALSE;
+    BOOL nonPreferable = FALSE;
+
+    for (size_t i = 0; i < m_criteriaCount; ++i)
+    {
+        COMPARISON result = m_criteria[i](first, second, m_tolerances[i]);
+
+        preferable |= result == COMPARISON::PREFERABLE;
+        nonPreferable |= result == COMPARISON::NON_PREFERABLE;
+    }
+
+    COMPARISON choice;
+    if (preferable && nonPreferable)
+        choice = COMPARISON::UNDEFINED;
+    else if (preferable)
+        choice = COMPARISON::PREFERABLE;
+    else if (nonPreferable)
+        choice = COMPARISON::NON_PREFERABLE;
+    else
+        choice = COMPARISON::EQUAL;
+
+    if (m_params.m_compareContent)
+    {
+        BOOL equalContent;
+        if (contentComparator)
+            equalContent = contentComparator->equalContent(first, second);
+        else
+            equalContent = ContentComparator(m_params, NULL).equalContent(first, second);
+
+        if (equalContent)
+            return COMPARISON::EQUAL;
+
+        // Content differs, but size and time do not tell which file is newer
+        return (choice == COMPARISON::EQUAL) ? COMPARISON::UNDEFINED : choice;
+    }
+
+    return choice;
+}
+
+void FileComparator::addCriterion(Criterion criterion, ULONGLONG tolerance)
+{
+    if (m_criteriaCount < MAX_CRITERIA)
+    {
+        m_criteria[m_criteriaCount] = criterion;
+        m_tolerances[m_criteriaCount] = tolerance;
+        ++m_criteriaCount;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "FileProperties.h"
+
+class ContentComparator;
+
+
+
+// Compares files by criteria of FileComparisonParameters
+// Criteria are chosen once, when comparator is made, and each of them
+// is a function specialized at compile time, so comparing a pair
+// of files neither allocates nor checks parameters again
+// Results of criteria are folded into two flags, see compare()
+// Times are compared with full precision of FILETIME, within tolerance
+// of FileComparisonParameters::m_timeTolerance
+class FileComparator
+{
+public:
+    using COMPARISON_RESULT = FileProperties::COMPARISON_RESULT;
+
+    explicit FileComparator(const FileComparisonParameters& params = FileComparisonParameters());
+
+    // EQUAL if every criterion gives EQUAL, UNDEFINED if criteria disagree
+    // If content is compared, files may be read, see ContentComparator;
+    // contentComparator may be NULL, then a temporary one without
+    // hash cache is used
+    COMPARISON_RESULT compare(const FileProperties& first,
+                              const FileProperties& second,
+                              ContentComparator* contentComparator = NULL) const;
+
+private:
+    using Criterion = COMPARISON_RESULT (*)(const FileProperties&,
+                                            const FileProperties&,
+                                            ULONGLONG tolerance);
+
+    // Property values, that differ by no more than tolerance, are equal
+    template<ULONGLONG (FileProperties::*getProperty)() const>
+    static COMPARISON_RESULT compareBy(const FileProperties& first,
+                                       const FileProperties& second,
+                                       ULONGLONG tolerance);
+
+    void addCriterion(Criterion criterion, ULONGLONG tolerance);
+
+    // Size and one of time stamps at most
+    static const size_t MAX_CRITERIA = 2;
+
+    Criterion m_criteria[MAX_CRITERIA];
+    ULONGLONG m_tolerances[MAX_CRITERIA];
+    size_t m_criteriaCount;
+
+    FileComparisonParameters m_params;
+};
+
+
+
+template<ULONGLONG (FileProperties::*getProperty)() const>
+FileComparator::COMPARISON_RESULT FileComparator::compareBy(const FileProperties& first,
+                                                            const FileProperties& second,
+                                                            ULONGLONG tolerance)
+{
+    ULONGLONG firstValue = (first.*getProperty)();
+    ULONGLONG secondValue = (second.*getProperty)();
+
+    ULONGLONG difference = (firstValue > secondValue) ? firstValue - secondValue
+                                                      : secondValue - firstValue;
+    if (difference <= tolerance)
+        return COMPARISON_RESULT::EQUAL;
+
+    return FileProperties::compareProperty(firstValue, secondValue);
+}
@@ -0,0 +1,939 @@
+#include "stdafx.h"
+#include "FileCopy.h"
+#include "TokenBucket.h"
+#include <winioctl.h>
+#include <algorithm>
+
+
+
+// Region of one FSCTL_DUPLICATE_EXTENTS_TO_FILE call must be less than 4 GB
+static const ULONGLONG CLONE_CHUNK_SIZE = 1024 * 1024 * 1024;
+
+// Smaller files are copied through system cache
+static const ULONGLONG UNBUFFERED_THRESHOLD = 64 * 1024 * 1024;
+
+// Blocks, that are read or written at once, per file
+static const DWORD UNBUFFERED_BLOCK_SIZE = 1024 * 1024;
+static const DWORD UNBUFFERED_BLOCK_COUNT = 4;
+
+// Unbuffered transfers must be multiples of sector size,
+// which does not exceed page size on common disks
+static const DWORD UNBUFFERED_ALIGNMENT = 4096;
+
+// Copies of larger files survive interruption
+static const ULONGLONG RESUMABLE_THRESHOLD = 1024ULL * 1024 * 1024;
+static const DWORD RESUMABLE_BLOCK_SIZE = 4 * 1024 * 1024;
+
+// Data is flushed and checkpoint is updated after this many bytes;
+// at most this much is copied again after a crash
+static const ULONGLONG CHECKPOINT_INTERVAL = 256 * 1024 * 1024;
+
+static const WCHAR STAGING_EXTENSION[] = L".sspart";
+
+// Existing destination is replaced by a complete copy with this extension
+static const WCHAR TEMPORARY_EXTENSION[] = L".sstmp";
+static const WCHAR CHECKPOINT_STREAM[] = L":SimpleSync.checkpoint";
+
+// Sparse files are copied range by range with blocks of this size
+static const DWORD SPARSE_BLOCK_SIZE = 1024 * 1024;
+static const size_t SPARSE_RANGES_PER_QUERY = 64;
+
+// Attributes, that can be given to an open file; zero means no change
+static const DWORD SETTABLE_ATTRIBUTES = FILE_ATTRIBUTE_READONLY |
+                                         FILE_ATTRIBUTE_HIDDEN |
+                                         FILE_ATTRIBUTE_SYSTEM |
+                                         FILE_ATTRIBUTE_ARCHIVE |
+                                         FILE_ATTRIBUTE_TEMPORARY |
+                                         FILE_ATTRIBUTE_NOT_CONTENT_INDEXED;
+
+
+static ULONGLONG getFileSize(const BY_HANDLE_FILE_INFORMATION& info)
+{
+    return ((ULONGLONG)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+}
+
+static LARGE_INTEGER toLargeInteger(const FILETIME& time)
+{
+    LARGE_INTEGER value;
+    value.LowPart = time.dwLowDateTime;
+    value.HighPart = (LONG)time.dwHighDateTime;
+    return value;
+}
+
+// Volume of the folder, that file is or would be in
+static BOOL getParentVolume(const CString& filePath, DWORD& volumeSerial)
+{
+    int slashPos = filePath.ReverseFind('\\');
+    if (slashPos == -1)
+        return FALSE;
+
+    // Trailing slash keeps root folder from meaning current folder of drive
+    HANDLE folder = CreateFile(filePath.Left(slashPos + 1),
+                               FILE_READ_ATTRIBUTES,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL,
+                               OPEN_EXISTING,
+                               FILE_FLAG_BACKUP_SEMANTICS,
+                               NULL);
+    if (folder == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    BY_HANDLE_FILE_INFORMATION info;
+    BOOL found = GetFileInformationByHandle(folder, &info);
+    CloseHandle(folder);
+
+    if (found)
+        volumeSerial = info.dwVolumeSerialNumber;
+    return found;
+}
+
+static BOOL setFileSize(HANDLE file, ULONGLONG size)
+{
+    FILE_END_OF_FILE_INFO endOfFile;
+    endOfFile.EndOfFile.QuadPart = (LONGLONG)size;
+
+    return SetFileInformationByHandle(file, FileEndOfFileInfo,
+                                      &endOfFile, sizeof(endOfFile));
+}
+
+static void chargeBytes(TokenBucket* byteLimit, ULONGLONG count)
+{
+    if (byteLimit)
+        byteLimit->acquire(count);
+}
+
+// Bytes, that CopyFileEx() has been charged for
+struct CopyProgressCharge
+{
+    TokenBucket* byteLimit;
+    ULONGLONG chargedBytes;
+};
+
+// Called by CopyFileEx() after each chunk; waiting here holds the copy back
+static DWORD CALLBACK chargeCopyProgress(LARGE_INTEGER totalFileSize,
+                                         LARGE_INTEGER totalBytesTransferred,
+                                         LARGE_INTEGER streamSize,
+                                         LARGE_INTEGER streamBytesTransferred,
+                                         DWORD streamNumber,
+                                         DWORD callbackReason,
+                                         HANDLE sourceFile,
+                                         HANDLE destinationFile,
+                                         LPVOID data)
+{
+    CopyProgressCharge* charge = (CopyProgressCharge*)data;
+
+    ULONGLONG transferred = (ULONGLONG)totalBytesTransferred.QuadPart;
+    if (transferred > charge->chargedBytes)
+    {
+        charge->byteLimit->acquire(transferred - charge->chargedBytes);
+        charge->chargedBytes = transferred;
+    }
+
+    return PROGRESS_CONTINUE;
+}
+
+// TRUE if file has any stream besides the unnamed data stream,
+// or if streams cannot be listed
+static BOOL hasAlternateStreams(HANDLE file)
+{
+    static const WCHAR DATA_STREAM[] = L"::$DATA";
+
+    // Room for several entries with short names; aligned for FILE_STREAM_INFO
+    LONGLONG buffer[64];
+    if (!GetFileInformationByHandleEx(file, FileStreamInfo, buffer, sizeof(buffer)))
+        return TRUE;
+
+    const FILE_STREAM_INFO* stream = (const FILE_STREAM_INFO*)buffer;
+    if (stream->NextEntryOffset != 0)
+        return TRUE;
+
+    return stream->StreamNameLength != sizeof(DATA_STREAM) - sizeof(WCHAR) ||
+           wcsncmp(stream->StreamName, DATA_STREAM, _countof(DATA_STREAM) - 1) != 0;
+}
+
+
+
+BOOL FileCopy::copyFile(const CString& sourcePath,
+                        const CString& destinationPath,
+                        BOOL overwrite,
+                        TokenBucket* byteLimit)
+{
+    // Fast ways never write over existing destination: they write
+    // a temporary file next to it, that replaces it once complete,
+    // and remove only the file they have created, if they fail
+    CString targetPath = overwrite ? destinationPath + TEMPORARY_EXTENSION
+                                   : destinationPath;
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    BOOL hasAttributes = GetFileAttributesEx(sourcePath, GetFileExInfoStandard,
+                                             &attributes);
+
+    BOOL copied = cloneFile(sourcePath, targetPath, overwrite);
+
+    if (!copied && hasAttributes)
+    {
+        BOOL isSparse = (attributes.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) != 0;
+        if (isSparse)
+            copied = copySparse(sourcePath, targetPath, overwrite, byteLimit);
+
+        ULONGLONG size = ((ULONGLONG)attributes.nFileSizeHigh << 32) |
+                         attributes.nFileSizeLow;
+
+        // Staging file of a failed copy is kept for the next run,
+        // so the file is not copied other ways meanwhile
+        BOOL resumable = !copied && size >= RESUMABLE_THRESHOLD;
+        if (resumable && copyResumable(sourcePath, destinationPath, overwrite,
+                                       byteLimit, resumable))
+            return TRUE;
+        if (resumable)
+            return FALSE;
+
+        BOOL isLarge = size >= UNBUFFERED_THRESHOLD;
+        if (!copied && isLarge)
+            copied = copyUnbuffered(sourcePath, targetPath, overwrite, byteLimit);
+    }
+
+    if (copied)
+        return !overwrite || replaceDestination(targetPath, destinationPath);
+
+    DWORD flags = overwrite ? 0 : COPY_FILE_FAIL_IF_EXISTS;
+
+    CopyProgressCharge charge = { byteLimit, 0 };
+    LPPROGRESS_ROUTINE progress = byteLimit ? chargeCopyProgress : NULL;
+
+    if (!CopyFileEx(sourcePath, destinationPath, progress, &charge, NULL, flags))
+        return FALSE;
+
+    // CopyFileEx() keeps write time only; file is copied in any case,
+    // if other times cannot be set, next scan may find it different
+    HANDLE destination = CreateFile(destinationPath, FILE_WRITE_ATTRIBUTES,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hasAttributes && destination != INVALID_HANDLE_VALUE)
+    {
+        FILE_BASIC_INFO basicInfo = {};
+        basicInfo.CreationTime = toLargeInteger(attributes.ftCreationTime);
+        basicInfo.LastAccessTime = toLargeInteger(attributes.ftLastAccessTime);
+
+        SetFileInformationByHandle(destination, FileBasicInfo,
+                                   &basicInfo, sizeof(basicInfo));
+    }
+    if (destination != INVALID_HANDLE_VALUE)
+        CloseHandle(destination);
+
+    return TRUE;
+}
+
+
+
+BOOL FileCopy::copySmallFile(const CString& sourcePath,
+                             const CString& destinationPath,
+                             std::vector<BYTE>& buffer,
+                             TokenBucket* byteLimit)
+{
+    HANDLE source = CreateFile(sourcePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (source == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    BY_HANDLE_FILE_INFORMATION info;
+    if (!GetFileInformationByHandle(source, &info))
+    {
+        CloseHandle(source);
+        return FALSE;
+    }
+
+    // File may have grown since scan; alternate data streams
+    // are copied only by CopyFileEx()
+    ULONGLONG size = getFileSize(info);
+    if (size > buffer.size() || hasAlternateStreams(source))
+    {
+        CloseHandle(source);
+        return copyFile(sourcePath, destinationPath, FALSE, byteLimit);
+    }
+
+    DWORD bytesRead = 0;
+    BOOL read = ReadFile(source, buffer.data(), (DWORD)size, &bytesRead, NULL) &&
+                bytesRead == size;
+    CloseHandle(source);
+
+    if (!read)
+        return FALSE;
+
+    HANDLE destination = createDestination(destinationPath, FALSE,
+                                           FILE_FLAG_SEQUENTIAL_SCAN);
+    if (destination == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    chargeBytes(byteLimit, bytesRead);
+
+    DWORD written = 0;
+    BOOL copied = WriteFile(destination, buffer.data(), bytesRead, &written, NULL) &&
+                  written == bytesRead;
+
+    if (copied)
+        copied = copyMetadata(destination, info);
+
+    if (!copied)
+    {
+        FILE_DISPOSITION_INFO disposition;
+        disposition.DeleteFile = TRUE;
+
+        SetFileInformationByHandle(destination, FileDispositionInfo,
+                                   &disposition, sizeof(disposition));
+    }
+
+    CloseHandle(destination);
+
+    return copied;
+}
+
+
+
+BOOL FileCopy::isStagingFile(LPCWSTR name, size_t nameLength)
+{
+    auto hasExtension = [name, nameLength](LPCWSTR extension, size_t extensionLength) {
+        return nameLength > extensionLength &&
+               _wcsnicmp(name + nameLength - extensionLength,
+                         extension, extensionLength) == 0;
+    };
+
+    return hasExtension(STAGING_EXTENSION, _countof(STAGING_EXTENSION) - 1) ||
+           hasExtension(TEMPORARY_EXTENSION, _countof(TEMPORARY_EXTENSION) - 1);
+}
+
+BOOL FileCopy::copyMetadata(HANDLE destination,
+                            const BY_HANDLE_FILE_INFORMATION& sourceInfo)
+{
+    // Times set through handle are not changed by writes or closing;
+    // zero attributes would mean no change
+    DWORD attributes = sourceInfo.dwFileAttributes & SETTABLE_ATTRIBUTES;
+
+    FILE_BASIC_INFO basicInfo = {};
+    basicInfo.CreationTime = toLargeInteger(sourceInfo.ftCreationTime);
+    basicInfo.LastAccessTime = toLargeInteger(sourceInfo.ftLastAccessTime);
+    basicInfo.LastWriteTime = toLargeInteger(sourceInfo.ftLastWriteTime);
+    basicInfo.FileAttributes = attributes ? attributes : FILE_ATTRIBUTE_NORMAL;
+
+    return SetFileInformationByHandle(destination, FileBasicInfo,
+                                      &basicInfo, sizeof(basicInfo));
+}
+
+
+
+BOOL FileCopy::cloneFile(const CString& sourcePath,
+                         const CString& destinationPath,
+                         BOOL overwrite)
+{
+    HANDLE source = CreateFile(sourcePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (source == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    DWORD volumeFlags = 0;
+    BOOL canClone = GetVolumeInformationByHandleW(source, NULL, 0, NULL, NULL,
+                                                  &volumeFlags, NULL, 0) &&
+                    (volumeFlags & FILE_SUPPORTS_BLOCK_REFCOUNTING) != 0;
+
+    // Extents are shared only within one volume, so destination is not
+    // created, unless its folder is on the volume of source
+    BY_HANDLE_FILE_INFORMATION info;
+    DWORD destinationVolume = 0;
+
+    if (canClone)
+        canClone = GetFileInformationByHandle(source, &info) &&
+                   getParentVolume(destinationPath, destinationVolume) &&
+                   destinationVolume == info.dwVolumeSerialNumber;
+
+    // Clone must keep integrity streams of source and needs cluster size
+    FSCTL_GET_INTEGRITY_INFORMATION_BUFFER integrity = {};
+    DWORD bytesReturned = 0;
+
+    if (canClone)
+        canClone = DeviceIoControl(source, FSCTL_GET_INTEGRITY_INFORMATION,
+                                   NULL, 0, &integrity, sizeof(integrity),
+                                   &bytesReturned, NULL) &&
+                   integrity.ClusterSizeInBytes != 0;
+
+    HANDLE destination = INVALID_HANDLE_VALUE;
+    if (canClone)
+        destination = createDestination(destinationPath, overwrite, 0);
+
+    if (destination == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(source);
+        return FALSE;
+    }
+
+    ULONGLONG size = getFileSize(info);
+    BOOL cloned = TRUE;
+
+    if (info.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE)
+        cloned = DeviceIoControl(destination, FSCTL_SET_SPARSE, NULL, 0,
+                                 NULL, 0, &bytesReturned, NULL);
+
+    if (cloned)
+    {
+        FSCTL_SET_INTEGRITY_INFORMATION_BUFFER setIntegrity = {};
+        setIntegrity.ChecksumAlgorithm = integrity.ChecksumAlgorithm;
+        setIntegrity.Flags = integrity.Flags;
+
+        cloned = DeviceIoControl(destination, FSCTL_SET_INTEGRITY_INFORMATION,
+                                 &setIntegrity, sizeof(setIntegrity),
+                                 NULL, 0, &bytesReturned, NULL);
+    }
+
+    if (cloned)
+        cloned = setFileSize(destination, size);
+
+    // Regions are whole clusters, the last one may end after end of file
+    ULONGLONG clusterSize = integrity.ClusterSizeInBytes;
+    ULONGLONG alignedSize = (size + clusterSize - 1) / clusterSize * clusterSize;
+
+    for (ULONGLONG offset = 0; cloned && offset < alignedSize; offset += CLONE_CHUNK_SIZE)
+    {
+        DUPLICATE_EXTENTS_DATA extents;
+        extents.FileHandle = source;
+        extents.SourceFileOffset.QuadPart = (LONGLONG)offset;
+        extents.TargetFileOffset.QuadPart = (LONGLONG)offset;
+        extents.ByteCount.QuadPart = (LONGLONG)(std::min)(CLONE_CHUNK_SIZE,
+                                                          alignedSize - offset);
+
+        // Fails, if files are on different volumes
+        cloned = DeviceIoControl(destination, FSCTL_DUPLICATE_EXTENTS_TO_FILE,
+                                 &extents, sizeof(extents),
+                                 NULL, 0, &bytesReturned, NULL);
+    }
+
+    CloseHandle(source);
+
+    return finishDestination(destination, info, cloned);
+}
+
+BOOL FileCopy::copySparse(const CString& sourcePath,
+                          const CString& destinationPath,
+                          BOOL overwrite,
+                          TokenBucket* byteLimit)
+{
+    HANDLE source = CreateFile(sourcePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (source == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    BY_HANDLE_FILE_INFORMATION info;
+    HANDLE destination = INVALID_HANDLE_VALUE;
+
+    if (GetFileInformationByHandle(source, &info))
+        destination = createDestination(destinationPath, overwrite,
+                                        FILE_FLAG_SEQUENTIAL_SCAN);
+
+    if (destination == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(source);
+        return FALSE;
+    }
+
+    ULONGLONG size = getFileSize(info);
+    DWORD bytesReturned = 0;
+
+    // Holes appear where nothing is written
+    BOOL copied = DeviceIoControl(destination, FSCTL_SET_SPARSE, NULL, 0,
+                                  NULL, 0, &bytesReturned, NULL) &&
+                  setFileSize(destination, size);
+
+    std::vector<BYTE> buffer(SPARSE_BLOCK_SIZE);
+    std::vector<FILE_ALLOCATED_RANGE_BUFFER> ranges(SPARSE_RANGES_PER_QUERY);
+
+    FILE_ALLOCATED_RANGE_BUFFER query;
+    query.FileOffset.QuadPart = 0;
+    query.Length.QuadPart = (LONGLONG)size;
+
+    BOOL moreRanges = copied;
+    while (moreRanges)
+    {
+        BOOL queried = DeviceIoControl(source, FSCTL_QUERY_ALLOCATED_RANGES,
+                                       &query, sizeof(query),
+                                       ranges.data(),
+                                       (DWORD)(ranges.size() * sizeof(ranges[0])),
+                                       &bytesReturned, NULL);
+        moreRanges = !queried && GetLastError() == ERROR_MORE_DATA;
+        copied = queried || moreRanges;
+
+        size_t rangeCount = bytesReturned / sizeof(ranges[0]);
+        if (rangeCount == 0)
+            break;
+
+        for (size_t i = 0; copied && i < rangeCount; ++i)
+        {
+            ULONGLONG offset = (ULONGLONG)ranges[i].FileOffset.QuadPart;
+            ULONGLONG end = offset + (ULONGLONG)ranges[i].Length.QuadPart;
+
+            LARGE_INTEGER position;
+            position.QuadPart = (LONGLONG)offset;
+            copied = SetFilePointerEx(source, position, NULL, FILE_BEGIN) &&
+                     SetFilePointerEx(destination, position, NULL, FILE_BEGIN);
+
+            while (copied && offset < end)
+            {
+                DWORD chunk = (DWORD)(std::min)((ULONGLONG)SPARSE_BLOCK_SIZE, end - offset);
+                DWORD bytesRead = 0;
+                DWORD written = 0;
+
+                copied = ReadFile(source, buffer.data(), chunk, &bytesRead, NULL) &&
+                         bytesRead == chunk;
+                if (!copied)
+                    break;
+
+                chargeBytes(byteLimit, chunk);
+                copied = WriteFile(destination, buffer.data(), chunk, &written, NULL) &&
+                         written == chunk;
+                offset += chunk;
+            }
+        }
+
+        // Next query starts after the last returned range
+        const FILE_ALLOCATED_RANGE_BUFFER& last = ranges[rangeCount - 1];
+        ULONGLONG queryStart = (ULONGLONG)last.FileOffset.QuadPart +
+                               (ULONGLONG)last.Length.QuadPart;
+
+        query.FileOffset.QuadPart = (LONGLONG)queryStart;
+        query.Length.QuadPart = (LONGLONG)(size - (std::min)(queryStart, size));
+
+        moreRanges = moreRanges && copied;
+    }
+
+    CloseHandle(source);
+
+    return finishDestination(destination, info, copied);
+}
+
+BOOL FileCopy::copyUnbuffered(const CString& sourcePath,
+                              const CString& destinationPath,
+                              BOOL overwrite,
+                              TokenBucket* byteLimit)
+{
+    const DWORD flags = FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED;
+
+    HANDLE source = CreateFile(sourcePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, flags, NULL);
+    if (source == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    BY_HANDLE_FILE_INFORMATION info;
+    HANDLE destination = INVALID_HANDLE_VALUE;
+
+    if (GetFileInformationByHandle(source, &info))
+        destination = createDestination(destinationPath, overwrite, flags);
+
+    if (destination == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(source);
+        return FALSE;
+    }
+
+    struct Block
+    {
+        OVERLAPPED overlapped;
+        BYTE* buffer;
+        ULONGLONG offset;
+        BOOL isWriting;
+        BOOL isPending;
+    };
+
+    Block blocks[UNBUFFERED_BLOCK_COUNT] = {};
+    HANDLE events[UNBUFFERED_BLOCK_COUNT] = {};
+
+    // Page-aligned buffers, all blocks in one allocation
+    BYTE* buffers = (BYTE*)VirtualAlloc(NULL,
+                                        UNBUFFERED_BLOCK_COUNT * UNBUFFERED_BLOCK_SIZE,
+                                        MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    BOOL copied = buffers != NULL;
+
+    for (DWORD i = 0; i < UNBUFFERED_BLOCK_COUNT; ++i)
+    {
+        events[i] = CreateEvent(NULL, TRUE, FALSE, NULL);
+        copied = copied && events[i] != NULL;
+
+        blocks[i].overlapped.hEvent = events[i];
+        if (buffers)
+            blocks[i].buffer = buffers + i * UNBUFFERED_BLOCK_SIZE;
+    }
+
+    ULONGLONG size = getFileSize(info);
+
+    // Space is taken at once, so that file is not fragmented
+    ULONGLONG alignedSize = (size + UNBUFFERED_ALIGNMENT - 1) /
+                            UNBUFFERED_ALIGNMENT * UNBUFFERED_ALIGNMENT;
+    if (copied)
+        copied = setFileSize(destination, alignedSize);
+
+    auto startTransfer = [&](Block& block, BOOL write, DWORD bytes) -> BOOL {
+        block.overlapped.Offset = (DWORD)block.offset;
+        block.overlapped.OffsetHigh = (DWORD)(block.offset >> 32);
+        block.isWriting = write;
+
+        BOOL started = write ? WriteFile(destination, block.buffer, bytes,
+                                         NULL, &block.overlapped)
+                             : ReadFile(source, block.buffer, bytes,
+                                        NULL, &block.overlapped);
+        block.isPending = started || GetLastError() == ERROR_IO_PENDING;
+        return block.isPending;
+    };
+
+    ULONGLONG nextOffset = 0;
+    DWORD pendingCount = 0;
+
+    for (Block& block : blocks)
+    {
+        if (!copied || nextOffset >= size)
+            break;
+
+        block.offset = nextOffset;
+        nextOffset += UNBUFFERED_BLOCK_SIZE;
+
+        copied = startTransfer(block, FALSE, UNBUFFERED_BLOCK_SIZE);
+        if (block.isPending)
+            ++pendingCount;
+    }
+
+    // Every block, that has been read, is written at the same offset
+    // and then reads the next part of file
+    while (pendingCount > 0)
+    {
+        DWORD waitResult = WaitForMultipleObjects(UNBUFFERED_BLOCK_COUNT, events,
+                                                  FALSE, INFINITE);
+        DWORD index = waitResult - WAIT_OBJECT_0;
+        if (index >= UNBUFFERED_BLOCK_COUNT)
+        {
+            copied = FALSE;
+            break;
+        }
+
+        Block& block = blocks[index];
+        HANDLE file = block.isWriting ? destination : source;
+
+        DWORD transferred = 0;
+        BOOL done = GetOverlappedResult(file, &block.overlapped, &transferred, FALSE);
+
+        ResetEvent(events[index]);
+        block.isPending = FALSE;
+        --pendingCount;
+
+        if (!done || transferred == 0)
+        {
+            // The rest of transfers are cancelled and waited for below
+            if (copied)
+            {
+                CancelIoEx(source, NULL);
+                CancelIoEx(destination, NULL);
+            }
+            copied = FALSE;
+        }
+
+        if (!copied)
+            continue;
+
+        if (!block.isWriting)
+        {
+            // Tail of the last block is cut off after copying
+            DWORD bytes = (transferred + UNBUFFERED_ALIGNMENT - 1) /
+                          UNBUFFERED_ALIGNMENT * UNBUFFERED_ALIGNMENT;
+
+            // Other blocks keep transferring while this one waits
+            chargeBytes(byteLimit, transferred);
+            copied = startTransfer(block, TRUE, bytes);
+        }
+        else if (nextOffset < size)
+        {
+            block.offset = nextOffset;
+            nextOffset += UNBUFFERED_BLOCK_SIZE;
+
+            copied = startTransfer(block, FALSE, UNBUFFERED_BLOCK_SIZE);
+        }
+
+        if (block.isPending)
+            ++pendingCount;
+    }
+
+    // Buffers cannot be freed while system uses them
+    if (pendingCount > 0)
+    {
+        CancelIoEx(source, NULL);
+        CancelIoEx(destination, NULL);
+
+        for (Block& block : blocks)
+        {
+            DWORD transferred = 0;
+            if (block.isPending)
+                GetOverlappedResult(block.isWriting ? destination : source,
+                                    &block.overlapped, &transferred, TRUE);
+        }
+    }
+
+    if (copied)
+        copied = setFileSize(destination, size);
+
+    for (HANDLE event : events)
+    {
+        if (event)
+            CloseHandle(event);
+    }
+    if (buffers)
+        VirtualFree(buffers, 0, MEM_RELEASE);
+
+    CloseHandle(source);
+
+    return finishDestination(destination, info, copied);
+}
+
+BOOL FileCopy::copyResumable(const CString& sourcePath,
+                             const CString& destinationPath,
+                             BOOL overwrite,
+                             TokenBucket* byteLimit,
+                             BOOL& resumable)
+{
+    resumable = FALSE;
+
+    if (!overwrite && GetFileAttributes(destinationPath) != INVALID_FILE_ATTRIBUTES)
+        return FALSE;
+
+    HANDLE source = CreateFile(sourcePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (source == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    BY_HANDLE_FILE_INFORMATION info;
+    if (!GetFileInformationByHandle(source, &info))
+    {
+        CloseHandle(source);
+        return FALSE;
+    }
+
+    CString stagingPath = destinationPath + STAGING_EXTENSION;
+    HANDLE staging = CreateFile(stagingPath, GENERIC_READ | GENERIC_WRITE | DELETE,
+                                0, NULL, OPEN_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (staging == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(source);
+        return FALSE;
+    }
+
+    Checkpoint checkpoint;
+    checkpoint.magic = CHECKPOINT_MAGIC;
+    checkpoint.version = CHECKPOINT_VERSION;
+    checkpoint.sourceSize = getFileSize(info);
+    checkpoint.sourceWriteTime = ((ULONGLONG)info.ftLastWriteTime.dwHighDateTime << 32) |
+                                 info.ftLastWriteTime.dwLowDateTime;
+    checkpoint.copiedSize = 0;
+    checkpoint.copiedHash = 0;
+
+    std::vector<BYTE> buffer(RESUMABLE_BLOCK_SIZE);
+    ContentHash hash;
+
+    // Staging file is trusted only if source did not change since it was
+    // left and its content still matches what checkpoint recorded
+    Checkpoint saved;
+    BOOL resume = readCheckpoint(stagingPath, saved) &&
+                  saved.sourceSize == checkpoint.sourceSize &&
+                  saved.sourceWriteTime == checkpoint.sourceWriteTime &&
+                  saved.copiedSize <= saved.sourceSize &&
+                  hashPrefix(staging, saved.copiedSize, buffer, hash) &&
+                  hash.digest() == saved.copiedHash;
+    if (resume)
+        checkpoint = saved;
+    else
+        hash = ContentHash();
+
+    // Anything written after the last checkpoint may be incomplete
+    LARGE_INTEGER position;
+    position.QuadPart = (LONGLONG)checkpoint.copiedSize;
+    BOOL copied = SetFilePointerEx(source, position, NULL, FILE_BEGIN) &&
+                  SetFilePointerEx(staging, position, NULL, FILE_BEGIN) &&
+                  SetEndOfFile(staging);
+
+    // Checkpoint is written before any data, so that volumes without
+    // alternate streams are found out before anything is copied
+    resumable = copied && writeCheckpoint(stagingPath, checkpoint);
+    if (!resumable)
+    {
+        CloseHandle(source);
+        CloseHandle(staging);
+        DeleteFile(stagingPath);
+        return FALSE;
+    }
+
+    ULONGLONG lastCheckpoint = checkpoint.copiedSize;
+    while (copied && checkpoint.copiedSize < checkpoint.sourceSize)
+    {
+        DWORD chunk = (DWORD)(std::min)((ULONGLONG)RESUMABLE_BLOCK_SIZE,
+                                        checkpoint.sourceSize - checkpoint.copiedSize);
+        DWORD bytesRead = 0;
+        DWORD written = 0;
+
+        copied = ReadFile(source, buffer.data(), chunk, &bytesRead, NULL) &&
+                 bytesRead == chunk;
+        if (!copied)
+            break;
+
+        chargeBytes(byteLimit, chunk);
+        copied = WriteFile(staging, buffer.data(), chunk, &written, NULL) &&
+                 written == chunk;
+        if (!copied)
+            break;
+
+        hash.update(buffer.data(), chunk);
+        checkpoint.copiedSize += chunk;
+
+        // Checkpoint must not get ahead of data on disk
+        if (checkpoint.copiedSize - lastCheckpoint >= CHECKPOINT_INTERVAL)
+        {
+            checkpoint.copiedHash = hash.digest();
+            copied = FlushFileBuffers(staging) &&
+                     writeCheckpoint(stagingPath, checkpoint);
+            lastCheckpoint = checkpoint.copiedSize;
+        }
+    }
+
+    CloseHandle(source);
+
+    // Complete copy is recorded too, so that the next run only renames it,
+    // if renaming fails now
+    if (copied && checkpoint.copiedSize != lastCheckpoint)
+    {
+        checkpoint.copiedHash = hash.digest();
+        copied = FlushFileBuffers(staging) &&
+                 writeCheckpoint(stagingPath, checkpoint);
+    }
+
+    CloseHandle(staging);
+
+    if (!copied)
+        return FALSE;
+
+    // Staging file becomes destination only when it is complete
+    // and keeps its checkpoint until then
+    if (!MoveFileEx(stagingPath, destinationPath, overwrite ? MOVEFILE_REPLACE_EXISTING : 0))
+        return FALSE;
+
+    // Removing the stream changes write time, and streams of a read-only
+    // file cannot be removed, so times and attributes are given last;
+    // file is copied in any case, as with CopyFileEx()
+    DeleteFile(destinationPath + CHECKPOINT_STREAM);
+
+    HANDLE destination = CreateFile(destinationPath, FILE_WRITE_ATTRIBUTES,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (destination != INVALID_HANDLE_VALUE)
+    {
+        copyMetadata(destination, info);
+        CloseHandle(destination);
+    }
+
+    return TRUE;
+}
+
+BOOL FileCopy::readCheckpoint(const CString& stagingPath, Checkpoint& checkpoint)
+{
+    HANDLE stream = CreateFile(stagingPath + CHECKPOINT_STREAM, GENERIC_READ,
+                               FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, NULL);
+    if (stream == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    DWORD bytesRead = 0;
+    BOOL read = ReadFile(stream, &checkpoint, sizeof(checkpoint), &bytesRead, NULL) &&
+                bytesRead == sizeof(checkpoint);
+    CloseHandle(stream);
+
+    return read &&
+           checkpoint.magic == CHECKPOINT_MAGIC &&
+           checkpoint.version == CHECKPOINT_VERSION;
+}
+
+BOOL FileCopy::writeCheckpoint(const CString& stagingPath, const Checkpoint& checkpoint)
+{
+    HANDLE stream = CreateFile(stagingPath + CHECKPOINT_STREAM, GENERIC_WRITE,
+                               0, NULL, OPEN_ALWAYS,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
+    if (stream == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    DWORD written = 0;
+    BOOL saved = WriteFile(stream, &checkpoint, sizeof(checkpoint), &written, NULL) &&
+                 written == sizeof(checkpoint);
+    CloseHandle(stream);
+
+    return saved;
+}
+
+BOOL FileCopy::hashPrefix(HANDLE file, ULONGLONG size,
+                          std::vector<BYTE>& buffer, ContentHash& hash)
+{
+    LARGE_INTEGER start = {};
+    if (!SetFilePointerEx(file, start, NULL, FILE_BEGIN))
+        return FALSE;
+
+    for (ULONGLONG offset = 0; offset < size; )
+    {
+        DWORD chunk = (DWORD)(std::min)((ULONGLONG)buffer.size(), size - offset);
+        DWORD bytesRead = 0;
+
+        if (!ReadFile(file, buffer.data(), chunk, &bytesRead, NULL) || bytesRead != chunk)
+            return FALSE;
+
+        hash.update(buffer.data(), chunk);
+        offset += chunk;
+    }
+
+    return TRUE;
+}
+
+
+
+BOOL FileCopy::replaceDestination(const CString& temporaryPath,
+                                  const CString& destinationPath)
+{
+    if (MoveFileEx(temporaryPath, destinationPath, MOVEFILE_REPLACE_EXISTING))
+        return TRUE;
+
+    // Copy may have got read-only attribute of source already
+    SetFileAttributes(temporaryPath, FILE_ATTRIBUTE_NORMAL);
+    DeleteFile(temporaryPath);
+    return FALSE;
+}
+
+HANDLE FileCopy::createDestination(const CString& destinationPath,
+                                   BOOL overwrite,
+                                   DWORD flags)
+{
+    return CreateFile(destinationPath,
+                      GENERIC_READ | GENERIC_WRITE | DELETE,
+                      0,
+                      NULL,
+                      overwrite ? CREATE_ALWAYS : CREATE_NEW,
+                      FILE_ATTRIBUTE_NORMAL | flags,
+                      NULL);
+}
+
+BOOL FileCopy::finishDestination(HANDLE destination,
+                                 const BY_HANDLE_FILE_INFORMATION& sourceInfo,
+                                 BOOL copied)
+{
+    if (copied)
+        copied = copyMetadata(destination, sourceInfo);
+
+    if (!copied)
+    {
+        // Partial copy is removed, so that the caller can copy from scratch
+        FILE_DISPOSITION_INFO disposition;
+        disposition.DeleteFile = TRUE;
+
+        SetFileInformationByHandle(destination, FileDispositionInfo,
+                                   &disposition, sizeof(disposition));
+    }
+
+    CloseHandle(destination);
+
+    return copied;
+}
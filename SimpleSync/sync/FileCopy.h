@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+
+#include "ContentHash.h"
+
+class TokenBucket;
+
+// Copies files the fastest way file system allows:
+// - on volumes with block cloning (ReFS) file is cloned, data is shared
+//   by both files until either of them is changed, nothing is read or written
+// - sparse files get only their allocated ranges copied, holes stay holes
+// - very large files are copied into a staging file next to destination,
+//   progress is kept in its checkpoint stream, so that an interrupted copy
+//   continues where it stopped on the next run
+// - large files are copied with unbuffered overlapped I/O, several blocks
+//   are read and written at once and system cache is not filled with them
+// - otherwise CopyFileEx() copies data inside the kernel
+// Existing destination is replaced only by a complete copy
+// All three times and attributes are copied, unlike CopyFile(), which keeps
+// only write time, so that copies do not differ from originals by any time
+// byteLimit, if given, is charged for each block as it is written;
+// cloning writes no data and is not charged
+class FileCopy
+{
+public:
+    // If overwrite is not set, fails when destination exists
+    static BOOL copyFile(const CString& sourcePath,
+                         const CString& destinationPath,
+                         BOOL overwrite,
+                         TokenBucket* byteLimit = NULL);
+
+    // Copy of a small file with as few calls as possible: source is read
+    // into buffer at once, write time and attributes are set with one call
+    // File, that does not fit into buffer or has alternate data streams,
+    // is copied with copyFile()
+    // Fails when destination exists
+    static BOOL copySmallFile(const CString& sourcePath,
+                              const CString& destinationPath,
+                              std::vector <BYTE>& buffer,
+                              TokenBucket* byteLimit = NULL);
+
+    // Staging files of unfinished copies are not synchronized themselves
+    static BOOL isStagingFile(LPCWSTR name, size_t nameLength);
+
+    // Gives open file times and attributes of source with one call
+    static BOOL copyMetadata(HANDLE destination,
+                             const BY_HANDLE_FILE_INFORMATION& sourceInfo);
+
+private:
+    // Written to checkpoint stream of staging file
+    struct Checkpoint
+    {
+        DWORD magic;
+        DWORD version;
+        ULONGLONG sourceSize;
+        ULONGLONG sourceWriteTime;
+        ULONGLONG copiedSize;
+
+        // Hash of copied part, checked against staging file before resuming
+        ULONGLONG copiedHash;
+    };
+
+    static const DWORD CHECKPOINT_MAGIC = 0x50435353; // "SSCP"
+    static const DWORD CHECKPOINT_VERSION = 1;
+
+
+    // Both return FALSE if file cannot be copied this way;
+    // destination is not left behind then
+
+    // Fails if volume cannot clone or files are on different volumes
+    static BOOL cloneFile(const CString& sourcePath,
+                          const CString& destinationPath,
+                          BOOL overwrite);
+
+    static BOOL copySparse(const CString& sourcePath,
+                           const CString& destinationPath,
+                           BOOL overwrite,
+                           TokenBucket* byteLimit);
+
+    static BOOL copyUnbuffered(const CString& sourcePath,
+                               const CString& destinationPath,
+                               BOOL overwrite,
+                               TokenBucket* byteLimit);
+
+    // Unlike others, leaves staging file behind when copy fails midway;
+    // resumable is cleared if file cannot be copied this way at all
+    static BOOL copyResumable(const CString& sourcePath,
+                              const CString& destinationPath,
+                              BOOL overwrite,
+                              TokenBucket* byteLimit,
+                              BOOL& resumable);
+
+    static BOOL readCheckpoint(const CString& stagingPath, Checkpoint& checkpoint);
+    static BOOL writeCheckpoint(const CString& stagingPath, const Checkpoint& checkpoint);
+
+    // Hashes first size bytes of file, leaves file pointer after them
+    static BOOL hashPrefix(HANDLE file, ULONGLONG size,
+                           std::vector <BYTE>& buffer, ContentHash& hash);
+
+    // Renames complete temporary copy over destination,
+    // temporary file is removed if that fails
+    static BOOL replaceDestination(const CString& temporaryPath,
+                                   const CString& destinationPath);
+
+    static HANDLE createDestination(const CString& destinationPath,
+                                    BOOL overwrite,
+                                    DWORD flags);
+
+    // Gives copied file times and attributes of source and closes it,
+    // or removes it, if it was not copied
+    static BOOL finishDestination(HANDLE destination,
+                                  const BY_HANDLE_FILE_INFORMATION& sourceInfo,
+                                  BOOL copied);
+};
@@ -1,20 +1,33 @@
 #include "stdafx.h"
 #include "FileProperties.h"
-#include <algorithm>
+#include "FileComparator.h"
 
 using COMPARISON = FileProperties::COMPARISON_RESULT;
 
 
-FileProperties::FileProperties(const CFileStatus& properties)
-    : m_properties(properties)
+FileProperties::FileProperties(const PathNode::ptr& parentFolder,
+                               const CString& name,
+                               const FileEntryInfo& info)
+    : m_parentFolder(parentFolder),
+      m_name(name),
+      m_info(info)
 {
 }
 
 FileProperties::FileProperties(const CString& fileName, BOOL isFolder)
 {
-    wcscpy_s(m_properties.m_szFullName, fileName);
+    int slashPos = fileName.ReverseFind('\\');
+
+    if (slashPos == -1)
+        m_name = fileName;
+    else
+    {
+        m_parentFolder = PathNode::makeRoot(fileName.Left(slashPos));
+        m_name = fileName.Mid(slashPos + 1);
+    }
+
     if (isFolder)
-        m_properties.m_attribute |= CFile::Attribute::directory;
+        m_info.attributes |= FILE_ATTRIBUTE_DIRECTORY;
 }
 
 FileProperties::~FileProperties()
@@ -24,130 +37,95 @@ FileProperties::~FileProperties()
 
 
 COMPARISON FileProperties::compareTo(const FileProperties& file,
-                                     const FileComparisonParameters& params) const
+                                     const FileComparisonParameters& params,
+                                     ContentComparator* contentComparator) const
 {
-    BOOL equalNames = this->getFileName() == file.getFileName();
-    if (!equalNames)
-        return COMPARISON::UNDEFINED;
-
-    ComparisonResults results;
-
-    if (params.m_compareSize)
-    {
-        COMPARISON sizeCompare = compareProperty(this->getSize(),
-                                                 file.getSize());
-        results.push_back(sizeCompare);
-    }
-
-    if (params.m_compareTime)
-    {
-        COMPARISON timeCompare;
-
-        switch (params.m_timeToCompare)
-        {
-        case TIME_STAMP::CREATION_TIME:
-            timeCompare = compareProperty(this->getCreationTime(),
-                                          file.getCreationTime());
-            break;
-        case TIME_STAMP::LAST_ACCESS_TIME:
-            timeCompare = compareProperty(this->getLastAccessTime(),
-                                          file.getLastAccessTime());
-            break;
-        case TIME_STAMP::LAST_WRITE_TIME:
-            timeCompare = compareProperty(this->getLastWriteTime(),
-                                          file.getLastWriteTime());
-            break;
-        }
-
-        results.push_back(timeCompare);
-    }
-
-    return makeChoice(results);
-}
-
-COMPARISON FileProperties::makeChoice(ComparisonResults& results) const
-{
-    results.remove(COMPARISON::EQUAL);
-
-    if (results.empty())
-        return COMPARISON::EQUAL;
-
-    auto it = std::find(results.begin(), results.end(), COMPARISON::PREFERABLE);
-    BOOL hasPreferable = it != results.end();
-
-    it = std::find(results.begin(), results.end(), COMPARISON::NON_PREFERABLE);
-    BOOL hasNonPreferable = it != results.end();
-
-    if (hasPreferable)
-    {
-        if (hasNonPreferable)
-            return COMPARISON::UNDEFINED;
-        else
-            return COMPARISON::PREFERABLE;
-    }
-    else
-        return COMPARISON::NON_PREFERABLE;
+    return FileComparator(params).compare(*this, file, contentComparator);
 }
 
 FileProperties FileProperties::operator=(const FileProperties& file)
 {
-    wcscpy_s(m_properties.m_szFullName, file.m_properties.m_szFullName);
-    
-    m_properties.m_size = file.m_properties.m_size;
-
-    m_properties.m_ctime = file.m_properties.m_ctime;
-    m_properties.m_mtime = file.m_properties.m_mtime;
-    m_properties.m_atime = file.m_properties.m_atime;
+    // Path is shared, not copied
+    m_parentFolder = file.m_parentFolder;
+    m_name = file.m_name;
 
-    m_properties.m_attribute = file.m_properties.m_attribute;
+    m_info = file.m_info;
 
     return *this;
 }
 
 BOOL FileProperties::operator<(const FileProperties& file) const
+{
+    return compareNames(file) < 0;
+}
+
+int FileProperties::compareNames(const FileProperties& file) const
 {
     BOOL isThisFolder = this->isFolder();
     BOOL isFileFolder = file.isFolder();
 
     if (isThisFolder != isFileFolder)
-        return isThisFolder ? FALSE : TRUE;
+        return isThisFolder ? 1 : -1;
     else
-        return (this->getFileName() < file.getFileName());
+        return _tcscmp(m_name, file.m_name);
 }
 
 BOOL FileProperties::operator==(const FileProperties& file) const
 {
-    int comp = _tcscmp(m_properties.m_szFullName,
-                       file.m_properties.m_szFullName);
-    BOOL name = comp == 0;
-    BOOL size = m_properties.m_size == file.m_properties.m_size;
-    BOOL times = (m_properties.m_ctime == file.m_properties.m_ctime) &&
-                 (m_properties.m_mtime == file.m_properties.m_mtime) &&
-                 (m_properties.m_atime == file.m_properties.m_atime);
-    BOOL attribs = m_properties.m_attribute == file.m_properties.m_attribute;
+    // Raw fields go first, they are the cheapest to compare;
+    // times are compared as FILETIME, without conversion to CTime
+    BOOL info = m_info.size == file.m_info.size &&
+                m_info.attributes == file.m_info.attributes &&
+                m_info.creationTime == file.m_info.creationTime &&
+                m_info.lastWriteTime == file.m_info.lastWriteTime &&
+                m_info.lastAccessTime == file.m_info.lastAccessTime;
 
-    return name && size && times && attribs;
+    return info &&
+           m_name == file.m_name &&
+           PathNode::equal(m_parentFolder.get(), file.m_parentFolder.get());
+}
+
+
+
+CTime FileProperties::toTime(ULONGLONG fileTime)
+{
+    FILETIME time;
+    time.dwLowDateTime = (DWORD)fileTime;
+    time.dwHighDateTime = (DWORD)(fileTime >> 32);
+
+    // Some file systems do not store all of the time stamps
+    if (fileTime == 0 || !CTime::IsValidFILETIME(time))
+        return CTime();
+
+    return CTime(time);
 }
 
 
 
 CString FileProperties::getFileName() const
 {
-    CString fullPath = getFullPath();
-    int slashPos = fullPath.ReverseFind('\\');
-    return fullPath.Right(fullPath.GetLength() - slashPos - 1);
+    return m_name;
 }
 
 CString FileProperties::getFullPath() const
 {
-    return m_properties.m_szFullName;
+    if (!m_parentFolder)
+        return m_name;
+
+    return m_parentFolder->getFullPath() + _T("\\") + m_name;
 }
 
 CString FileProperties::getParentFolder() const
 {
-    CString fullPath = getFullPath();
-    int slashPos = fullPath.ReverseFind('\\');
-    return fullPath.Left(slashPos);
+    if (!m_parentFolder)
+        return CString();
+
+    return m_parentFolder->getFullPath();
+}
+
+PathNode::ptr FileProperties::makePathNode() const
+{
+    return PathNode::make(m_parentFolder, m_name);
 }
 
 CString FileProperties::getRelativePath(const CString& rootFolder,
@@ -175,27 +153,52 @@ CString FileProperties::getRelativePath(const CString& rootFolder,
 
 ULONGLONG FileProperties::getSize() const
 {
-    return m_properties.m_size;
+    return m_info.size;
+}
+
+ULONGLONG FileProperties::getFileId() const
+{
+    return m_info.fileId;
+}
+
+DWORD FileProperties::getVolumeSerial() const
+{
+    return m_info.volumeSerial;
+}
+
+ULONGLONG FileProperties::getCreationFileTime() const
+{
+    return m_info.creationTime;
+}
+
+ULONGLONG FileProperties::getLastAccessFileTime() const
+{
+    return m_info.lastAccessTime;
+}
+
+ULONGLONG FileProperties::getLastWriteFileTime() const
+{
+    return m_info.lastWriteTime;
 }
 
 CTime FileProperties::getCreationTime() const
 {
-    return m_properties.m_ctime;
+    return toTime(m_info.creationTime);
 }
 
 CTime FileProperties::getLastAccessTime() const
 {
-    return m_properties.m_atime;
+    return toTime(m_info.lastAccessTime);
 }
 
 CTime FileProperties::getLastWriteTime() const
 {
-    return m_properties.m_mtime;
+    return toTime(m_info.lastWriteTime);
 }
 
 BOOL FileProperties::isFolder() const
 {
-    return (m_properties.m_attribute & CFile::Attribute::directory) ==
+    return (m_info.attributes & CFile::Attribute::directory) ==
         CFile::Attribute::directory;
 }
 
@@ -206,24 +209,24 @@ BOOL FileProperties::isParentFolder(const FileProperties& folder) const
 
 BOOL FileProperties::isArchived() const
 {
-    return (m_properties.m_attribute & CFile::Attribute::archive) ==
+    return (m_info.attributes & CFile::Attribute::archive) ==
         CFile::Attribute::archive;
 }
 
 BOOL FileProperties::isSystem() const
 {
-    return (m_properties.m_attribute & CFile::Attribute::system) ==
+    return (m_info.attributes & CFile::Attribute::system) ==
         CFile::Attribute::system;
 }
 
 BOOL FileProperties::isHidden() const
 {
-    return (m_properties.m_attribute & CFile::Attribute::hidden) ==
+    return (m_info.attributes & CFile::Attribute::hidden) ==
         CFile::Attribute::hidden;
 }
 
 BOOL FileProperties::isReadOnly() const
 {
-    return (m_properties.m_attribute & CFile::Attribute::readOnly) ==
+    return (m_info.attributes & CFile::Attribute::readOnly) ==
         CFile::Attribute::readOnly;
 }
@@ -1,13 +1,31 @@
 #pragma once
 
-#include <list>
+#include "PathNode.h"
 
 struct FileComparisonParameters;
+class ContentComparator;
+
+
+// Values of a single directory entry, as file system reports them
+// Times are FILETIME values (100 ns intervals since 1601, UTC)
+struct FileEntryInfo
+{
+    ULONGLONG size = 0;
+    ULONGLONG creationTime = 0;
+    ULONGLONG lastAccessTime = 0;
+    ULONGLONG lastWriteTime = 0;
+    ULONGLONG fileId = 0;
+    DWORD attributes = 0;
+
+    // Volume, file ID is unique within; 0 if unknown
+    DWORD volumeSerial = 0;
+};
 
 
 
 // Contains file properties, such as:
 // full path to file, size, time stamps and system attributes
+// Path is kept as parent PathNode and name, full path is built on demand
 class FileProperties
 {
 public:
@@ -24,14 +42,13 @@ public:
         LAST_ACCESS_TIME
     };
 
-    using ComparisonResults = std::list <COMPARISON_RESULT>;
-
-    // TODO: rewrite comparison mechanism to support arbitrary amount
-    //       of parameters (maybe using map of comparator functors)
-    // TODO: check for correctness CFileStatus struct's members
     // TODO: exceptions
     // TODO: probably add temporary flag
-    FileProperties(const CFileStatus& properties);
+    // Builds properties straight from directory enumeration record,
+    // so file does not have to be opened again to get its status
+    FileProperties(const PathNode::ptr& parentFolder,
+                   const CString& name,
+                   const FileEntryInfo& info);
     FileProperties(const CString& fileName = _T(""), BOOL isFolder = FALSE);
     ~FileProperties();
 
@@ -40,24 +57,43 @@ public:
     template<class T>
     static COMPARISON_RESULT compareProperty(const T& first, const T& second);
 
+    // Same as FileComparator::compare(); criteria are chosen on every call,
+    // so FileComparator should be kept when many files are compared
     COMPARISON_RESULT compareTo(const FileProperties& file,
-                                const FileComparisonParameters& params) const;
+                                const FileComparisonParameters& params,
+                                ContentComparator* contentComparator = NULL) const;
 
     FileProperties operator= (const FileProperties& file);
 
-    // Required by SyncManager::FileSet to sort files by name
+    // Required by SyncManager::FileList to sort files by name
     // in lexicographical order
-    // in addition, folders precede files;
+    // in addition, files precede folders;
     BOOL operator< (const FileProperties& file) const;
     BOOL operator== (const FileProperties& file) const;
 
+    // Three-way version of operator<: negative, zero or positive value
+    // Does not allocate
+    int compareNames(const FileProperties& file) const;
+
     CString getFileName() const;
     CString getFullPath() const;
     CString getParentFolder() const;
+
+    // Node of this file, to be shared by files inside of it
+    PathNode::ptr makePathNode() const;
     CString getRelativePath(const CString& rootFolder, BOOL withName) const;
 
     ULONGLONG getSize() const;
 
+    // File system index of the file (NTFS file ID); 0 if unknown
+    ULONGLONG getFileId() const;
+    DWORD getVolumeSerial() const;
+
+    // Raw FILETIME values, see FileEntryInfo
+    ULONGLONG getCreationFileTime() const;
+    ULONGLONG getLastAccessFileTime() const;
+    ULONGLONG getLastWriteFileTime() const;
+
     CTime getCreationTime() const;
     CTime getLastAccessTime() const;
     CTime getLastWriteTime() const;
@@ -71,9 +107,13 @@ public:
     BOOL isReadOnly() const;
 
 private:
-    COMPARISON_RESULT makeChoice(ComparisonResults& results) const;
+    static CTime toTime(ULONGLONG fileTime);
+
+    // NULL for a file, whose name is a full path
+    PathNode::ptr m_parentFolder;
+    CString m_name;
 
-    CFileStatus m_properties;
+    FileEntryInfo m_info;
 };
 
 
@@ -83,6 +123,19 @@ struct FileComparisonParameters
     BOOL m_compareTime = FALSE;
     FileProperties::TIME_STAMP m_timeToCompare =
         FileProperties::TIME_STAMP::LAST_WRITE_TIME;
+
+    // Times, that differ by no more than this, are equal, in milliseconds
+    // FAT keeps write time with 2 s precision, other file systems
+    // round times too, so copies would never look equal otherwise
+    UINT m_timeTolerance = 2000;
+
+    // Files with the same content are equal, whatever their times are;
+    // files with different content are chosen by size and time
+    BOOL m_compareContent = FALSE;
+
+    // Content is compared byte by byte instead of hashes,
+    // and files of the same write time are read too, see ContentComparator
+    BOOL m_compareBytes = FALSE;
 };
 
 
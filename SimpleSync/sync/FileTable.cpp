@@ -0,0 +1,130 @@
+#include "stdafx.h"
+#include "FileTable.h"
+#include <algorithm>
+
+
+
+void FileTable::clear()
+{
+    m_sizes.clear();
+    m_creationTimes.clear();
+    m_lastAccessTimes.clear();
+    m_lastWriteTimes.clear();
+    m_fileIds.clear();
+    m_attributes.clear();
+    m_volumeSerials.clear();
+
+    m_nameOffsets.clear();
+    m_nameLengths.clear();
+    m_names.clear();
+}
+
+void FileTable::reserve(size_t count)
+{
+    m_sizes.reserve(count);
+    m_creationTimes.reserve(count);
+    m_lastAccessTimes.reserve(count);
+    m_lastWriteTimes.reserve(count);
+    m_fileIds.reserve(count);
+    m_attributes.reserve(count);
+    m_volumeSerials.reserve(count);
+
+    m_nameOffsets.reserve(count);
+    m_nameLengths.reserve(count);
+}
+
+FileTable::Handle FileTable::add(LPCWSTR name, size_t nameLength, const FileEntryInfo& info)
+{
+    Handle file = (Handle)m_sizes.size();
+
+    m_sizes.push_back(info.size);
+    m_creationTimes.push_back(info.creationTime);
+    m_lastAccessTimes.push_back(info.lastAccessTime);
+    m_lastWriteTimes.push_back(info.lastWriteTime);
+    m_fileIds.push_back(info.fileId);
+    m_attributes.push_back(info.attributes);
+    m_volumeSerials.push_back(info.volumeSerial);
+
+    m_nameOffsets.push_back((UINT32)m_names.size());
+    m_nameLengths.push_back((UINT32)nameLength);
+    m_names.append(name, nameLength);
+
+    return file;
+}
+
+size_t FileTable::size() const
+{
+    return m_sizes.size();
+}
+
+
+
+LPCWSTR FileTable::getName(Handle file) const
+{
+    return m_names.data() + m_nameOffsets[file];
+}
+
+size_t FileTable::getNameLength(Handle file) const
+{
+    return m_nameLengths[file];
+}
+
+DWORD FileTable::getAttributes(Handle file) const
+{
+    return m_attributes[file];
+}
+
+BOOL FileTable::isFolder(Handle file) const
+{
+    return (m_attributes[file] & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
+FileEntryInfo FileTable::getInfo(Handle file) const
+{
+    FileEntryInfo info;
+    info.size = m_sizes[file];
+    info.creationTime = m_creationTimes[file];
+    info.lastAccessTime = m_lastAccessTimes[file];
+    info.lastWriteTime = m_lastWriteTimes[file];
+    info.fileId = m_fileIds[file];
+    info.attributes = m_attributes[file];
+    info.volumeSerial = m_volumeSerials[file];
+    return info;
+}
+
+
+
+int FileTable::compareNames(Handle file, const FileTable& otherTable, Handle otherFile) const
+{
+    BOOL isThisFolder = isFolder(file);
+    BOOL isOtherFolder = otherTable.isFolder(otherFile);
+
+    if (isThisFolder != isOtherFolder)
+        return isThisFolder ? 1 : -1;
+
+    size_t length = m_nameLengths[file];
+    size_t otherLength = otherTable.m_nameLengths[otherFile];
+
+    int result = wmemcmp(getName(file), otherTable.getName(otherFile),
+                         (std::min)(length, otherLength));
+    if (result != 0)
+        return result;
+
+    if (length == otherLength)
+        return 0;
+    return length < otherLength ? -1 : 1;
+}
+
+void FileTable::sort(Handles& files) const
+{
+    std::sort(files.begin(), files.end(), [this](Handle first, Handle second) {
+        return compareNames(first, *this, second) < 0;
+    });
+}
+
+FileProperties FileTable::makeFileProperties(Handle file,
+                                             const PathNode::ptr& parentFolder) const
+{
+    CString name(getName(file), (int)getNameLength(file));
+    return FileProperties(parentFolder, name, getInfo(file));
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "FileProperties.h"
+
+
+
+// Entries of one folder, as they were enumerated or stored in snapshot
+// Values are kept column by column and names share one buffer, so that
+// filtering, sorting and merging touch only the values they need,
+// instead of a whole FileProperties per entry
+// FileProperties are made only for entries that get into operations
+class FileTable
+{
+public:
+    // Row of the table
+    using Handle = UINT32;
+    using Handles = std::vector <Handle>;
+
+    void clear();
+    void reserve(size_t count);
+
+    // Name does not need terminating zero
+    Handle add(LPCWSTR name, size_t nameLength, const FileEntryInfo& info);
+
+    size_t size() const;
+
+    LPCWSTR getName(Handle file) const;
+    size_t getNameLength(Handle file) const;
+
+    DWORD getAttributes(Handle file) const;
+    BOOL isFolder(Handle file) const;
+
+    FileEntryInfo getInfo(Handle file) const;
+
+    // Same order as FileProperties::operator<: files precede folders,
+    // then names are compared lexicographically
+    int compareNames(Handle file, const FileTable& otherTable, Handle otherFile) const;
+
+    // Sorts handles with compareNames()
+    void sort(Handles& files) const;
+
+    FileProperties makeFileProperties(Handle file, const PathNode::ptr& parentFolder) const;
+
+private:
+    std::vector <ULONGLONG> m_sizes;
+    std::vector <ULONGLONG> m_creationTimes;
+    std::vector <ULONGLONG> m_lastAccessTimes;
+    std::vector <ULONGLONG> m_lastWriteTimes;
+    std::vector <ULONGLONG> m_fileIds;
+    std::vector <DWORD> m_attributes;
+    std::vector <DWORD> m_volumeSerials;
+
+    // Position and length of name in m_names
+    std::vector <UINT32> m_nameOffsets;
+    std::vector <UINT32> m_nameLengths;
+    std::wstring m_names;
+};
@@ -0,0 +1,193 @@
+#include "stdafx.h"
+#include "FolderWatcher.h"
+
+
+
+// Notifications from network shares cannot exceed 64 KB
+static const DWORD NOTIFICATION_BUFFER_SIZE = 64 * 1024;
+
+static const DWORD NOTIFICATION_FILTER = FILE_NOTIFY_CHANGE_FILE_NAME |
+                                         FILE_NOTIFY_CHANGE_DIR_NAME |
+                                         FILE_NOTIFY_CHANGE_ATTRIBUTES |
+                                         FILE_NOTIFY_CHANGE_SIZE |
+                                         FILE_NOTIFY_CHANGE_LAST_WRITE |
+                                         FILE_NOTIFY_CHANGE_CREATION;
+
+
+FolderWatcher::FolderWatcher()
+    : m_folderHandle(INVALID_HANDLE_VALUE),
+      m_stopEvent(NULL),
+      m_delay(0),
+      m_buffer(NOTIFICATION_BUFFER_SIZE / sizeof(DWORD))
+{
+}
+
+FolderWatcher::~FolderWatcher()
+{
+    stop();
+}
+
+
+
+BOOL FolderWatcher::start(const CString& folder,
+                          DWORD delayMilliseconds,
+                          ChangeCallback callback)
+{
+    stop();
+
+    m_folderHandle = CreateFile(folder,
+                                FILE_LIST_DIRECTORY,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_EXISTING,
+                                FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                                NULL);
+    if (m_folderHandle == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    m_stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!m_stopEvent)
+    {
+        CloseHandle(m_folderHandle);
+        m_folderHandle = INVALID_HANDLE_VALUE;
+        return FALSE;
+    }
+
+    m_delay = delayMilliseconds;
+    m_callback = callback;
+
+    m_thread = std::thread(&FolderWatcher::watchLoop, this);
+
+    return TRUE;
+}
+
+void FolderWatcher::stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    SetEvent(m_stopEvent);
+    m_thread.join();
+
+    CloseHandle(m_stopEvent);
+    CloseHandle(m_folderHandle);
+
+    m_stopEvent = NULL;
+    m_folderHandle = INVALID_HANDLE_VALUE;
+}
+
+BOOL FolderWatcher::isWatching() const
+{
+    return m_thread.joinable();
+}
+
+
+
+void FolderWatcher::watchLoop()
+{
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!overlapped.hEvent)
+        return;
+
+    // Sorted and unique, so every folder is scanned once per batch
+    std::set<CString> changedFolders;
+    BOOL changesLost = FALSE;
+    ULONGLONG lastChangeTime = 0;
+
+    BOOL requested = requestChanges(&overlapped);
+
+    while (requested)
+    {
+        DWORD timeout = INFINITE;
+        BOOL hasChanges = !changedFolders.empty() || changesLost;
+
+        if (hasChanges)
+        {
+            ULONGLONG elapsed = GetTickCount64() - lastChangeTime;
+            timeout = (elapsed >= m_delay) ? 0 : (DWORD)(m_delay - elapsed);
+        }
+
+        HANDLE events[] = { m_stopEvent, overlapped.hEvent };
+        DWORD waitResult = WaitForMultipleObjects(2, events, FALSE, timeout);
+
+        if (waitResult == WAIT_OBJECT_0 + 1)
+        {
+            DWORD bytesReturned = 0;
+            if (!GetOverlappedResult(m_folderHandle, &overlapped,
+                                     &bytesReturned, FALSE))
+                break;
+
+            // Zero bytes means that system buffer overflowed
+            if (bytesReturned == 0)
+                changesLost = TRUE;
+            else
+                addChanges((const BYTE*)m_buffer.data(), changedFolders);
+
+            lastChangeTime = GetTickCount64();
+
+            // Next request is issued before the callback runs,
+            // so that no change is missed while folders are synchronized
+            requested = requestChanges(&overlapped);
+        }
+        else if (waitResult == WAIT_TIMEOUT)
+        {
+            FolderChanges changes;
+            changes.folders.assign(changedFolders.begin(), changedFolders.end());
+            changes.changesLost = changesLost;
+
+            changedFolders.clear();
+            changesLost = FALSE;
+
+            m_callback(changes);
+        }
+        else
+            break;
+    }
+
+    CancelIoEx(m_folderHandle, &overlapped);
+
+    DWORD bytesReturned = 0;
+    GetOverlappedResult(m_folderHandle, &overlapped, &bytesReturned, TRUE);
+
+    CloseHandle(overlapped.hEvent);
+}
+
+BOOL FolderWatcher::requestChanges(OVERLAPPED* overlapped)
+{
+    ResetEvent(overlapped->hEvent);
+
+    return ReadDirectoryChangesW(m_folderHandle,
+                                 m_buffer.data(),
+                                 NOTIFICATION_BUFFER_SIZE,
+                                 TRUE,
+                                 NOTIFICATION_FILTER,
+                                 NULL,
+                                 overlapped,
+                                 NULL);
+}
+
+void FolderWatcher::addChanges(const BYTE* notifications,
+                               std::set<CString>& folders) const
+{
+    const BYTE* position = notifications;
+
+    for (;;)
+    {
+        auto notification = (const FILE_NOTIFY_INFORMATION*)position;
+
+        CString name(notification->FileName,
+                     notification->FileNameLength / sizeof(WCHAR));
+
+        // Any change of an entry is a change of its parent folder content
+        int slashPos = name.ReverseFind('\\');
+        if (slashPos == -1)
+            folders.insert(CString());
+        else
+            folders.insert(_T("\\") + name.Left(slashPos));
+
+        if (notification->NextEntryOffset == 0)
+            break;
+        position += notification->NextEntryOffset;
+    }
+}
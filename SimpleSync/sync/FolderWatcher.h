@@ -0,0 +1,65 @@
+#pragma once
+
+#include <set>
+#include <thread>
+#include <vector>
+#include <functional>
+
+
+
+// Changes collected by FolderWatcher during one debounce interval
+struct FolderChanges
+{
+    // Folders, whose content has changed, relative to watched folder
+    // (empty string - watched folder itself, otherwise starts with '\')
+    std::vector <CString> folders;
+
+    // Set when system notification buffer overflowed, so changes were lost
+    // and the whole tree has to be scanned again
+    BOOL changesLost = FALSE;
+};
+
+
+// Watches folder and all of its subfolders with ReadDirectoryChangesW()
+// on a separate thread
+// Notifications are coalesced by folder and reported once no new change
+// has come during the delay
+class FolderWatcher
+{
+public:
+    // Called on watcher thread
+    using ChangeCallback = std::function <void (const FolderChanges&)>;
+
+    FolderWatcher();
+    ~FolderWatcher();
+
+    FolderWatcher(const FolderWatcher&) = delete;
+    FolderWatcher& operator= (const FolderWatcher&) = delete;
+
+    BOOL start(const CString& folder,
+               DWORD delayMilliseconds,
+               ChangeCallback callback);
+
+    // Waits until running callback (if any) returns,
+    // so callback should return soon once its owner stops watching
+    void stop();
+
+    BOOL isWatching() const;
+
+private:
+    void watchLoop();
+
+    BOOL requestChanges(OVERLAPPED* overlapped);
+    void addChanges(const BYTE* notifications, std::set <CString>& folders) const;
+
+    HANDLE m_folderHandle;
+    HANDLE m_stopEvent;
+
+    DWORD m_delay;
+    ChangeCallback m_callback;
+
+    // DWORD elements keep notification records aligned
+    std::vector <DWORD> m_buffer;
+
+    std::thread m_thread;
+};
@@ -0,0 +1,283 @@
+#include "stdafx.h"
+#include "HashCache.h"
+#include "ContentHash.h"
+#include <algorithm>
+
+
+
+HashCache::HashCache()
+    : m_file(INVALID_HANDLE_VALUE),
+      m_mapping(NULL),
+      m_view(NULL),
+      m_header(NULL),
+      m_records(NULL),
+      m_hits(0),
+      m_misses(0)
+{
+}
+
+HashCache::~HashCache()
+{
+    close();
+}
+
+
+
+BOOL HashCache::load(const CString& cachePath)
+{
+    close();
+
+    m_file = CreateFile(cachePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    LARGE_INTEGER fileSize;
+    BOOL hasHeader = GetFileSizeEx(m_file, &fileSize) &&
+                     (ULONGLONG)fileSize.QuadPart >= sizeof(Header);
+    if (hasHeader)
+    {
+        m_mapping = CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping)
+            m_view = (const BYTE*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    if (!m_view)
+    {
+        close();
+        return FALSE;
+    }
+
+    m_header = (const Header*)m_view;
+
+    ULONGLONG bytesLeft = fileSize.QuadPart - sizeof(Header);
+    BOOL valid = m_header->magic == CACHE_MAGIC &&
+                 m_header->version == CACHE_VERSION &&
+                 bytesLeft % sizeof(Record) == 0 &&
+                 m_header->recordCount == bytesLeft / sizeof(Record);
+    if (!valid)
+    {
+        close();
+        return FALSE;
+    }
+
+    m_records = (const Record*)(m_view + sizeof(Header));
+
+    size_t recordCount = (size_t)m_header->recordCount;
+    m_usedRecords.reset(new std::atomic<bool>[recordCount]);
+    for (size_t i = 0; i < recordCount; ++i)
+        m_usedRecords[i] = false;
+
+    return TRUE;
+}
+
+BOOL HashCache::save(const CString& cachePath)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (cachePath.IsEmpty())
+        return FALSE;
+
+    DWORD generation = (m_header ? m_header->generation : 0) + 1;
+
+    std::vector<Record> records;
+    records.reserve((m_header ? (size_t)m_header->recordCount : 0) +
+                    m_newRecords.size());
+
+    for (size_t i = 0; m_header && i < m_header->recordCount; ++i)
+    {
+        Record record = m_records[i];
+
+        if (m_usedRecords[i])
+            record.generation = generation;
+
+        // Eviction of files, that are gone or have not been compared for long
+        if (generation - record.generation <= MAX_UNUSED_SAVES)
+            records.push_back(record);
+    }
+
+    for (Record record : m_newRecords)
+    {
+        record.generation = generation;
+        records.push_back(record);
+    }
+
+    // Mapped file is replaced below
+    close();
+    m_newRecords.clear();
+
+    auto recordLess = [](const Record& first, const Record& second) {
+        return compareKeys(first.key, second.key) < 0;
+    };
+    auto recordEqual = [](const Record& first, const Record& second) {
+        return compareKeys(first.key, second.key) == 0;
+    };
+    std::sort(records.begin(), records.end(), recordLess);
+    records.erase(std::unique(records.begin(), records.end(), recordEqual),
+                  records.end());
+
+    Header header;
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.generation = generation;
+    header.reserved = 0;
+    header.recordCount = records.size();
+
+    CString temporaryPath = cachePath + _T(".tmp");
+    HANDLE file = CreateFile(temporaryPath, GENERIC_WRITE, 0, NULL,
+                             CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    auto write = [file](const void* data, size_t size) -> BOOL {
+        const BYTE* position = (const BYTE*)data;
+
+        // WriteFile() takes DWORD size
+        while (size > 0)
+        {
+            DWORD chunk = (DWORD)(std::min)(size, (size_t)1 << 30);
+            DWORD written = 0;
+
+            if (!WriteFile(file, position, chunk, &written, NULL) || written == 0)
+                return FALSE;
+
+            position += written;
+            size -= written;
+        }
+        return TRUE;
+    };
+
+    BOOL written = write(&header, sizeof(header)) &&
+                   write(records.data(), records.size() * sizeof(Record));
+    CloseHandle(file);
+
+    if (written)
+        written = MoveFileEx(temporaryPath, cachePath, MOVEFILE_REPLACE_EXISTING);
+
+    if (!written)
+        DeleteFile(temporaryPath);
+
+    return written;
+}
+
+BOOL HashCache::getHash(const FileProperties& file, ULONGLONG& hash)
+{
+    if (findHash(file, hash))
+        return TRUE;
+
+    ++m_misses;
+
+    if (!ContentHash::hashFile(file.getFullPath(), hash))
+        return FALSE;
+
+    Key key;
+    if (makeKey(file, key))
+    {
+        Record record;
+        record.key = key;
+        record.hash = hash;
+        record.generation = 0;
+        record.reserved = 0;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_newRecords.push_back(record);
+    }
+
+    return TRUE;
+}
+
+BOOL HashCache::findHash(const FileProperties& file, ULONGLONG& hash)
+{
+    Key key;
+    if (!makeKey(file, key))
+        return FALSE;
+
+    const Record* record = findRecord(key);
+    if (!record)
+        return FALSE;
+
+    m_usedRecords[record - m_records] = true;
+    hash = record->hash;
+
+    ++m_hits;
+    return TRUE;
+}
+
+ULONGLONG HashCache::getHits() const
+{
+    return m_hits;
+}
+
+ULONGLONG HashCache::getMisses() const
+{
+    return m_misses;
+}
+
+
+
+BOOL HashCache::makeKey(const FileProperties& file, Key& key)
+{
+    key.fileId = file.getFileId();
+    key.size = file.getSize();
+    key.lastWriteTime = file.getLastWriteFileTime();
+    key.volumeSerial = file.getVolumeSerial();
+    key.reserved = 0;
+
+    return key.fileId != 0 && key.volumeSerial != 0;
+}
+
+int HashCache::compareKeys(const Key& first, const Key& second)
+{
+    if (first.volumeSerial != second.volumeSerial)
+        return first.volumeSerial < second.volumeSerial ? -1 : 1;
+    if (first.fileId != second.fileId)
+        return first.fileId < second.fileId ? -1 : 1;
+    if (first.size != second.size)
+        return first.size < second.size ? -1 : 1;
+    if (first.lastWriteTime != second.lastWriteTime)
+        return first.lastWriteTime < second.lastWriteTime ? -1 : 1;
+    return 0;
+}
+
+const HashCache::Record* HashCache::findRecord(const Key& key) const
+{
+    if (!m_view)
+        return NULL;
+
+    size_t first = 0;
+    size_t last = (size_t)m_header->recordCount;
+
+    while (first < last)
+    {
+        size_t middle = first + (last - first) / 2;
+        int result = compareKeys(m_records[middle].key, key);
+
+        if (result == 0)
+            return &m_records[middle];
+
+        if (result < 0)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    return NULL;
+}
+
+void HashCache::close()
+{
+    if (m_view)
+        UnmapViewOfFile(m_view);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+    m_view = NULL;
+
+    m_header = NULL;
+    m_records = NULL;
+    m_usedRecords.reset();
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "FileProperties.h"
+
+
+
+// Content hashes of files from previous scans, so that unchanged files
+// are not read again, see ContentHash
+// File is identified by volume, file ID, size and write time:
+// writing into file changes its write time or size
+//
+// Saved cache is mapped into memory and used read-only, so scanning threads
+// look it up without locks; hashes of new files are collected under a mutex
+// Every save rewrites the file sorted and without entries, that have not
+// been used during the last MAX_UNUSED_SAVES saves
+class HashCache
+{
+public:
+    HashCache();
+    ~HashCache();
+
+    HashCache(const HashCache&) = delete;
+    HashCache& operator= (const HashCache&) = delete;
+
+    // Returns FALSE if file is missing, has another version or is damaged;
+    // cache is still usable then, just empty
+    BOOL load(const CString& cachePath);
+
+    // Unmaps loaded cache, as the file is replaced
+    BOOL save(const CString& cachePath);
+
+    // Returns cached hash if file has not changed since it was hashed,
+    // otherwise reads the file; can be called from several threads at once
+    BOOL getHash(const FileProperties& file, ULONGLONG& hash);
+
+    // Same as getHash(), but never reads the file
+    BOOL findHash(const FileProperties& file, ULONGLONG& hash);
+
+    ULONGLONG getHits() const;
+    ULONGLONG getMisses() const;
+
+private:
+    // File layout: Header, Record[recordCount] sorted by key
+    static const DWORD CACHE_MAGIC = 0x48435353; // "SSCH"
+    static const DWORD CACHE_VERSION = 1;
+    static const DWORD MAX_UNUSED_SAVES = 16;
+
+    struct Key
+    {
+        ULONGLONG fileId;
+        ULONGLONG size;
+        ULONGLONG lastWriteTime;
+        DWORD volumeSerial;
+        DWORD reserved;
+    };
+
+    struct Header
+    {
+        DWORD magic;
+        DWORD version;
+        DWORD generation;
+        DWORD reserved;
+        ULONGLONG recordCount;
+    };
+
+    struct Record
+    {
+        Key key;
+        ULONGLONG hash;
+        // Number of the save, at which record was used last time
+        DWORD generation;
+        DWORD reserved;
+    };
+
+    // Files without file ID cannot be identified, so they are not cached
+    static BOOL makeKey(const FileProperties& file, Key& key);
+    static int compareKeys(const Key& first, const Key& second);
+
+    // Binary search in mapped records
+    const Record* findRecord(const Key& key) const;
+
+    void close();
+
+    HANDLE m_file;
+    HANDLE m_mapping;
+    const BYTE* m_view;
+
+    const Header* m_header;
+    const Record* m_records;
+
+    // One flag per mapped record, set when the record is used
+    std::unique_ptr <std::atomic <bool>[]> m_usedRecords;
+
+    std::mutex m_mutex;
+    std::vector <Record> m_newRecords;
+
+    std::atomic <ULONGLONG> m_hits;
+    std::atomic <ULONGLONG> m_misses;
+};
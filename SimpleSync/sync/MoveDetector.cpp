@@ -0,0 +1,150 @@
+#include "stdafx.h"
+#include "MoveDetector.h"
+#include <unordered_map>
+#include <algorithm>
+#include <vector>
+
+
+
+MoveDetector::MoveDetector(const FileComparisonParameters& params,
+                           ContentComparator* contentComparator)
+    : m_params(params),
+      m_contentComparator(contentComparator)
+{
+}
+
+MoveDetector::~MoveDetector()
+{
+}
+
+
+
+size_t MoveDetector::detectMoves(OperationQueue& operations)
+{
+    // Removed files by size, with their positions in queue
+    std::unordered_multimap<ULONGLONG, size_t> removals;
+
+    for (size_t i = 0; i < operations.size(); ++i)
+    {
+        const SyncOperation* operation = operations[i].get();
+
+        BOOL isFileRemoval = operation->getType() == SyncOperation::TYPE::REMOVE &&
+                             !operation->isForbidden() &&
+                             !operation->getFile().isFolder();
+        if (isFileRemoval)
+            removals.emplace(operation->getFile().getSize(), i);
+    }
+
+    if (removals.empty())
+        return 0;
+
+    std::vector<BOOL> replaced(operations.size(), FALSE);
+
+    // Removals of old parent folders, that came before a move,
+    // are put right after it: (position of move, position of removal)
+    std::vector<std::pair<size_t, size_t>> delayed;
+    std::vector<size_t> delayedTo(operations.size(), 0);
+
+    size_t moveCount = 0;
+
+    for (size_t i = 0; i < operations.size(); ++i)
+    {
+        if (operations[i]->getType() != SyncOperation::TYPE::COPY ||
+            operations[i]->isForbidden())
+            continue;
+
+        auto copy = std::static_pointer_cast<CopyOperation>(operations[i]);
+        FileProperties copiedFile = copy->getFile();
+
+        auto candidates = removals.equal_range(copiedFile.getSize());
+        for (auto candidate = candidates.first; candidate != candidates.second; ++candidate)
+        {
+            size_t removalPosition = candidate->second;
+            FileProperties removedFile = operations[removalPosition]->getFile();
+
+            if (!sameFiles(copiedFile, removedFile))
+                continue;
+
+            // Move takes place of the copy, after creation of its folder
+            operations[i] = std::make_shared<MoveOperation>(
+                copiedFile, removedFile, copy->getDestinationFolder());
+            replaced[removalPosition] = TRUE;
+
+            CString removedPath = removedFile.getFullPath();
+            for (size_t j = removalPosition + 1; j < i; ++j)
+            {
+                const SyncOperation* operation = operations[j].get();
+
+                BOOL removesAncestor = operation->getType() == SyncOperation::TYPE::REMOVE &&
+                                       operation->getFile().isFolder() &&
+                                       removedPath.Find(operation->getFile().getFullPath() +
+                                                        _T("\\")) == 0;
+                if (removesAncestor && delayedTo[j] < i)
+                {
+                    replaced[j] = TRUE;
+                    delayedTo[j] = i;
+                    delayed.emplace_back(i, j);
+                }
+            }
+
+            removals.erase(candidate);
+            ++moveCount;
+            break;
+        }
+    }
+
+    if (moveCount == 0)
+        return 0;
+
+    // Removal delayed by several moves goes after the last of them;
+    // delayed removals keep their order, so subfolders go before parents
+    std::sort(delayed.begin(), delayed.end());
+    auto nextDelayed = delayed.begin();
+
+    OperationQueue remaining;
+    for (size_t i = 0; i < operations.size(); ++i)
+    {
+        if (!replaced[i])
+            remaining.push_back(operations[i]);
+
+        for (; nextDelayed != delayed.end() && nextDelayed->first == i; ++nextDelayed)
+        {
+            if (delayedTo[nextDelayed->second] == i)
+                remaining.push_back(operations[nextDelayed->second]);
+        }
+    }
+    operations.swap(remaining);
+
+    return moveCount;
+}
+
+
+
+BOOL MoveDetector::sameFiles(const FileProperties& copiedFile,
+                             const FileProperties& removedFile) const
+{
+    ULONGLONG firstTime = copiedFile.getLastWriteFileTime();
+    ULONGLONG secondTime = removedFile.getLastWriteFileTime();
+    ULONGLONG timeDifference = firstTime > secondTime ? firstTime - secondTime
+                                                      : secondTime - firstTime;
+
+    // Tolerance is in milliseconds, file times are in 100 ns
+    if (timeDifference > (ULONGLONG)m_params.m_timeTolerance * 10000)
+        return FALSE;
+
+    // Unrelated files may have the same size and write time, a few blocks
+    // are read from both files to make sure; small files are hashed whole
+    ULONGLONG size = copiedFile.getSize();
+    ULONGLONG firstSample = 0;
+    ULONGLONG secondSample = 0;
+
+    BOOL sampled = ContentComparator::sampleFile(copiedFile.getFullPath(), size, firstSample) &&
+                   ContentComparator::sampleFile(removedFile.getFullPath(), size, secondSample);
+    if (!sampled || firstSample != secondSample)
+        return FALSE;
+
+    if (m_contentComparator)
+        return m_contentComparator->equalContent(copiedFile, removedFile);
+
+    return TRUE;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <deque>
+
+#include "operations/CopyOperation.h"
+#include "operations/RemoveOperation.h"
+#include "operations/MoveOperation.h"
+#include "ContentComparator.h"
+
+
+
+// Finds files, that were moved or renamed on one side: such a file is
+// copied to its new place and removed from the old one, so both
+// operations are replaced by one MoveOperation of the removed file
+// Removed files are indexed by size; a candidate must also have the same
+// write time (within time tolerance) and the same sampled content,
+// and equal content, if content is compared, see ContentComparator
+class MoveDetector
+{
+public:
+    using OperationQueue = std::deque <SyncOperation::ptr>;
+
+    // contentComparator may be NULL, if content is not compared
+    MoveDetector(const FileComparisonParameters& params,
+                 ContentComparator* contentComparator);
+    ~MoveDetector();
+
+    // Move takes position of the copy, so that it comes after creation
+    // of the new parent folder; removals of old parent folders, that
+    // come earlier, are put after the move
+    // Returns number of moves
+    size_t detectMoves(OperationQueue& operations);
+
+private:
+    BOOL sameFiles(const FileProperties& copiedFile,
+                   const FileProperties& removedFile) const;
+
+    const FileComparisonParameters m_params;
+    ContentComparator* m_contentComparator;
+};
@@ -0,0 +1,112 @@
+#include "stdafx.h"
+#include "OperationExecutor.h"
+
+
+
+OperationExecutor::OperationExecutor(size_t threadCount,
+                                     const ExecuteFunction& execute)
+    : m_execute(execute),
+      m_pool(threadCount)
+{
+}
+
+OperationExecutor::~OperationExecutor()
+{
+    wait();
+}
+
+
+
+void OperationExecutor::add(const SyncOperation::ptr& operation)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t index = m_tasks.size();
+    m_tasks.emplace_back();
+    m_tasks.back().operation = operation;
+
+    CString createdPath = operation->getCreatedPath();
+    if (!createdPath.IsEmpty())
+    {
+        auto creator = m_createdPaths.find(getParentPath(createdPath));
+        if (creator != m_createdPaths.end())
+            addDependency(index, creator->second);
+
+        m_createdPaths[createdPath] = index;
+    }
+
+    CString removedPath = operation->getRemovedPath();
+    if (!removedPath.IsEmpty())
+    {
+        auto content = m_removedContent.find(removedPath);
+        if (content != m_removedContent.end())
+        {
+            for (size_t removal : content->second)
+                addDependency(index, removal);
+
+            m_removedContent.erase(content);
+        }
+
+        m_removedContent[getParentPath(removedPath)].push_back(index);
+    }
+
+    if (m_tasks[index].waitingFor == 0)
+        submit(index);
+}
+
+void OperationExecutor::wait()
+{
+    m_pool.wait();
+}
+
+
+
+void OperationExecutor::addDependency(size_t task, size_t dependency)
+{
+    Task& dependencyTask = m_tasks[dependency];
+    if (dependencyTask.done)
+        return;
+
+    dependencyTask.dependents.push_back(task);
+    ++m_tasks[task].waitingFor;
+}
+
+void OperationExecutor::submit(size_t task)
+{
+    m_pool.submit([this, task]() {
+        run(task);
+    });
+}
+
+void OperationExecutor::run(size_t task)
+{
+    SyncOperation::ptr operation;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        operation = m_tasks[task].operation;
+    }
+
+    m_execute(operation);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Task& doneTask = m_tasks[task];
+    doneTask.done = TRUE;
+    doneTask.operation.reset();
+
+    for (size_t dependent : doneTask.dependents)
+    {
+        if (--m_tasks[dependent].waitingFor == 0)
+            submit(dependent);
+    }
+    doneTask.dependents.clear();
+}
+
+CString OperationExecutor::getParentPath(const CString& path)
+{
+    int slashPos = path.ReverseFind('\\');
+    if (slashPos == -1)
+        return CString();
+
+    return path.Left(slashPos);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <functional>
+
+#include "operations/SyncOperation.h"
+#include "WorkStealingPool.h"
+
+
+
+// Executes operations on a pool of threads, as soon as operations
+// they depend on are done:
+// - operation, that creates a path, waits for creation of its parent folder
+// - removal of a folder waits for removal of everything inside of it
+// Dependencies are found by paths, see SyncOperation::getCreatedPath(),
+// so operations may be added while earlier ones are executed
+class OperationExecutor
+{
+public:
+    // Called on pool threads
+    using ExecuteFunction = std::function <void (SyncOperation::ptr&)>;
+
+    // threadCount == 0 means one thread per hardware thread
+    OperationExecutor(size_t threadCount, const ExecuteFunction& execute);
+    ~OperationExecutor();
+
+    OperationExecutor(const OperationExecutor&) = delete;
+    OperationExecutor& operator= (const OperationExecutor&) = delete;
+
+    // Operations must be added in queue order: folder creation before
+    // its content, removal of content before removal of its folder
+    void add(const SyncOperation::ptr& operation);
+
+    // Blocks until every added operation is executed
+    void wait();
+
+private:
+    struct Task
+    {
+        SyncOperation::ptr operation;
+
+        // Number of tasks, that have to be done before this one
+        size_t waitingFor = 0;
+        std::vector <size_t> dependents;
+        BOOL done = FALSE;
+    };
+
+    // Called under m_mutex
+    void addDependency(size_t task, size_t dependency);
+    void submit(size_t task);
+
+    void run(size_t task);
+
+    static CString getParentPath(const CString& path);
+
+    ExecuteFunction m_execute;
+
+    std::mutex m_mutex;
+
+    // Deque keeps references to tasks valid while it grows
+    std::deque <Task> m_tasks;
+
+    // Task, that creates path
+    std::map <CString, size_t> m_createdPaths;
+
+    // Removal tasks, by the folder they are removed from
+    std::map <CString, std::vector <size_t>> m_removedContent;
+
+    WorkStealingPool m_pool;
+};
@@ -0,0 +1,61 @@
+#include "stdafx.h"
+#include "OperationStream.h"
+
+
+
+OperationStream::OperationStream(size_t capacity)
+    : m_capacity(capacity),
+      m_closed(FALSE)
+{
+    if (m_capacity == 0)
+        m_capacity = 1;
+}
+
+
+
+void OperationStream::push(const SyncOperation::ptr& operation)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_notFull.wait(lock, [this]() {
+        return m_operations.size() < m_capacity || m_closed;
+    });
+
+    if (m_closed)
+        return;
+
+    m_operations.push_back(operation);
+
+    lock.unlock();
+    m_notEmpty.notify_one();
+}
+
+BOOL OperationStream::pop(SyncOperation::ptr& operation)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_notEmpty.wait(lock, [this]() {
+        return !m_operations.empty() || m_closed;
+    });
+
+    if (m_operations.empty())
+        return FALSE;
+
+    operation = m_operations.front();
+    m_operations.pop_front();
+
+    lock.unlock();
+    m_notFull.notify_one();
+
+    return TRUE;
+}
+
+void OperationStream::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = TRUE;
+    }
+    m_notFull.notify_all();
+    m_notEmpty.notify_all();
+}
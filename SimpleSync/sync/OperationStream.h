@@ -0,0 +1,40 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include "operations/SyncOperation.h"
+
+
+
+// Bounded queue, that passes operations from scanning threads
+// to the thread, that executes them
+// Operations come out in the order they were pushed, so operations
+// pushed by one thread keep their relative order
+class OperationStream
+{
+public:
+    OperationStream(size_t capacity);
+
+    // Blocks while the stream is full; operations pushed after close()
+    // are dropped
+    void push(const SyncOperation::ptr& operation);
+
+    // Blocks until an operation is available
+    // Returns FALSE once the stream is closed and empty
+    BOOL pop(SyncOperation::ptr& operation);
+
+    // No more operations will be pushed
+    void close();
+
+private:
+    size_t m_capacity;
+    BOOL m_closed;
+
+    std::deque <SyncOperation::ptr> m_operations;
+
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+};
@@ -0,0 +1,83 @@
+#include "stdafx.h"
+#include "PathNode.h"
+
+
+
+PathNode::PathNode(const ptr& parent, const CString& name)
+    : m_parent(parent),
+      m_name(name)
+{
+}
+
+
+
+PathNode::ptr PathNode::makeRoot(const CString& path)
+{
+    return make(nullptr, path);
+}
+
+PathNode::ptr PathNode::make(const ptr& parent, const CString& name)
+{
+    // Constructor is private, so std::make_shared cannot be used
+    return ptr(new PathNode(parent, name));
+}
+
+CString PathNode::getFullPath() const
+{
+    int length = 0;
+    for (const PathNode* node = this; node; node = node->m_parent.get())
+        length += node->m_name.GetLength() + (node->m_parent ? 1 : 0);
+
+    CString path;
+    LPTSTR buffer = path.GetBuffer(length);
+
+    // Filled from the end, names are written once
+    int position = length;
+    for (const PathNode* node = this; node; node = node->m_parent.get())
+    {
+        int nameLength = node->m_name.GetLength();
+        position -= nameLength;
+        memcpy(buffer + position, (LPCTSTR)node->m_name, nameLength * sizeof(TCHAR));
+
+        if (node->m_parent)
+            buffer[--position] = '\\';
+    }
+
+    path.ReleaseBuffer(length);
+    return path;
+}
+
+const PathNode::ptr& PathNode::getParent() const
+{
+    return m_parent;
+}
+
+const CString& PathNode::getName() const
+{
+    return m_name;
+}
+
+BOOL PathNode::equal(const PathNode* first, const PathNode* second)
+{
+    // Different chains may still describe the same path,
+    // e.g. a root that was made from a full path of a subfolder
+    while (first && second)
+    {
+        if (first == second)
+            return TRUE;
+
+        if (!first->m_parent || !second->m_parent)
+            break;
+
+        if (first->m_name != second->m_name)
+            return FALSE;
+
+        first = first->m_parent.get();
+        second = second->m_parent.get();
+    }
+
+    if (!first || !second)
+        return first == second;
+
+    return first->getFullPath() == second->getFullPath();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+
+
+
+// Folder of an interned path tree: every folder keeps only its own name
+// and a reference to its parent, so files of one folder share the whole
+// chain of parent folders instead of storing full paths
+// Nodes are immutable once created and can be shared between threads
+class PathNode
+{
+public:
+    using ptr = std::shared_ptr <const PathNode>;
+
+    // Top of the tree; path is stored as is (e.g. "C:\Folder")
+    static ptr makeRoot(const CString& path);
+
+    // parent may be NULL, then the node is a root
+    static ptr make(const ptr& parent, const CString& name);
+
+    // Builds full path by walking to the root; no length limit
+    CString getFullPath() const;
+
+    const ptr& getParent() const;
+    const CString& getName() const;
+
+    // Compares full paths without building them
+    static BOOL equal(const PathNode* first, const PathNode* second);
+
+private:
+    PathNode(const ptr& parent, const CString& name);
+
+    ptr m_parent;
+    CString m_name;
+};
@@ -0,0 +1,294 @@
+#include "stdafx.h"
+#include "ScanSnapshot.h"
+#include <algorithm>
+
+
+
+ScanSnapshot::ScanSnapshot()
+    : m_file(INVALID_HANDLE_VALUE),
+      m_mapping(NULL),
+      m_view(NULL),
+      m_header(NULL),
+      m_folders(NULL),
+      m_entries(NULL),
+      m_names(NULL)
+{
+}
+
+ScanSnapshot::~ScanSnapshot()
+{
+    close();
+}
+
+
+
+BOOL ScanSnapshot::load(const CString& snapshotPath)
+{
+    close();
+
+    m_file = CreateFile(snapshotPath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    LARGE_INTEGER fileSize;
+    BOOL hasHeader = GetFileSizeEx(m_file, &fileSize) &&
+                     (ULONGLONG)fileSize.QuadPart >= sizeof(Header);
+    if (hasHeader)
+    {
+        m_mapping = CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping)
+            m_view = (const BYTE*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    if (!m_view)
+    {
+        close();
+        return FALSE;
+    }
+
+    m_header = (const Header*)m_view;
+
+    BOOL validHeader = m_header->magic == SNAPSHOT_MAGIC &&
+                       m_header->version == SNAPSHOT_VERSION;
+
+    // Counts are checked one by one, so that their sum cannot overflow
+    ULONGLONG bytesLeft = fileSize.QuadPart - sizeof(Header);
+    BOOL validSize = validHeader &&
+                     m_header->folderCount <= bytesLeft / sizeof(FolderRecord);
+    if (validSize)
+    {
+        bytesLeft -= m_header->folderCount * sizeof(FolderRecord);
+        validSize = m_header->entryCount <= bytesLeft / sizeof(EntryRecord);
+    }
+    if (validSize)
+    {
+        bytesLeft -= m_header->entryCount * sizeof(EntryRecord);
+        validSize = m_header->namesLength * sizeof(WCHAR) == bytesLeft;
+    }
+
+    if (!validSize)
+    {
+        close();
+        return FALSE;
+    }
+
+    const BYTE* position = m_view + sizeof(Header);
+
+    m_folders = (const FolderRecord*)position;
+    position += m_header->folderCount * sizeof(FolderRecord);
+
+    m_entries = (const EntryRecord*)position;
+    position += m_header->entryCount * sizeof(EntryRecord);
+
+    m_names = (LPCWSTR)position;
+
+    return TRUE;
+}
+
+void ScanSnapshot::close()
+{
+    if (m_view)
+        UnmapViewOfFile(m_view);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+    m_view = NULL;
+
+    m_header = NULL;
+    m_folders = NULL;
+    m_entries = NULL;
+    m_names = NULL;
+}
+
+BOOL ScanSnapshot::getFolderEntries(SIDE side,
+                                    const CString& relativePath,
+                                    const FolderStamp& stamp,
+                                    FileTable& entries) const
+{
+    const FolderRecord* folder = findFolder(side, relativePath);
+    if (!folder)
+        return FALSE;
+
+    BOOL unchanged = folder->stamp.volumeSerial == stamp.volumeSerial &&
+                     folder->stamp.fileId == stamp.fileId &&
+                     folder->stamp.lastWriteTime == stamp.lastWriteTime;
+    if (!unchanged)
+        return FALSE;
+
+    BOOL validRange = folder->firstEntry <= m_header->entryCount &&
+                      folder->entryCount <= m_header->entryCount - folder->firstEntry;
+    if (!validRange)
+        return FALSE;
+
+    entries.clear();
+    entries.reserve((size_t)folder->entryCount);
+
+    for (ULONGLONG i = 0; i < folder->entryCount; ++i)
+    {
+        const EntryRecord& record = m_entries[folder->firstEntry + i];
+
+        BOOL validName = record.nameOffset <= m_header->namesLength &&
+                         record.nameLength <= m_header->namesLength - record.nameOffset;
+        if (!validName)
+            return FALSE;
+
+        entries.add(m_names + record.nameOffset, record.nameLength, record.info);
+    }
+
+    return TRUE;
+}
+
+
+
+int ScanSnapshot::compareFolders(DWORD firstSide, LPCWSTR firstPath, size_t firstLength,
+                                 DWORD secondSide, LPCWSTR secondPath, size_t secondLength)
+{
+    if (firstSide != secondSide)
+        return firstSide < secondSide ? -1 : 1;
+
+    int result = wmemcmp(firstPath, secondPath, (std::min)(firstLength, secondLength));
+    if (result != 0)
+        return result;
+
+    if (firstLength == secondLength)
+        return 0;
+    return firstLength < secondLength ? -1 : 1;
+}
+
+const ScanSnapshot::FolderRecord* ScanSnapshot::findFolder(SIDE side,
+                                                           const CString& relativePath) const
+{
+    if (!m_view)
+        return NULL;
+
+    // Binary search, folder records are sorted by writer
+    size_t first = 0;
+    size_t last = (size_t)m_header->folderCount;
+
+    while (first < last)
+    {
+        size_t middle = first + (last - first) / 2;
+        const FolderRecord& folder = m_folders[middle];
+
+        BOOL validPath = folder.pathOffset <= m_header->namesLength &&
+                         folder.pathLength <= m_header->namesLength - folder.pathOffset;
+        if (!validPath)
+            return NULL;
+
+        int result = compareFolders(folder.side, m_names + folder.pathOffset,
+                                    folder.pathLength,
+                                    (DWORD)side, relativePath,
+                                    relativePath.GetLength());
+        if (result == 0)
+            return &folder;
+
+        if (result < 0)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    return NULL;
+}
+
+
+
+void ScanSnapshotWriter::addFolder(ScanSnapshot::SIDE side,
+                                   const CString& relativePath,
+                                   const FolderStamp& stamp,
+                                   const FileTable& entries)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ScanSnapshot::FolderRecord folder;
+    folder.stamp = stamp;
+    folder.side = (DWORD)side;
+    folder.pathLength = relativePath.GetLength();
+    folder.pathOffset = m_names.size();
+    folder.firstEntry = m_entries.size();
+    folder.entryCount = entries.size();
+
+    m_names.append(relativePath, relativePath.GetLength());
+    m_folders.push_back(folder);
+
+    for (FileTable::Handle entry = 0; entry < entries.size(); ++entry)
+    {
+        ScanSnapshot::EntryRecord record;
+        record.info = entries.getInfo(entry);
+        record.nameOffset = m_names.size();
+        record.nameLength = (DWORD)entries.getNameLength(entry);
+        record.reserved = 0;
+
+        m_names.append(entries.getName(entry), entries.getNameLength(entry));
+        m_entries.push_back(record);
+    }
+}
+
+BOOL ScanSnapshotWriter::save(const CString& snapshotPath)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (snapshotPath.IsEmpty())
+        return FALSE;
+
+    const std::wstring& names = m_names;
+    auto folderLess = [&names](const ScanSnapshot::FolderRecord& first,
+                               const ScanSnapshot::FolderRecord& second) {
+        int result = ScanSnapshot::compareFolders(
+            first.side, names.data() + first.pathOffset, first.pathLength,
+            second.side, names.data() + second.pathOffset, second.pathLength);
+        return result < 0;
+    };
+    // Folder records refer to entries by index, so only they are sorted
+    std::sort(m_folders.begin(), m_folders.end(), folderLess);
+
+    ScanSnapshot::Header header;
+    header.magic = ScanSnapshot::SNAPSHOT_MAGIC;
+    header.version = ScanSnapshot::SNAPSHOT_VERSION;
+    header.folderCount = m_folders.size();
+    header.entryCount = m_entries.size();
+    header.namesLength = m_names.size();
+
+    CString temporaryPath = snapshotPath + _T(".tmp");
+    HANDLE file = CreateFile(temporaryPath, GENERIC_WRITE, 0, NULL,
+                             CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    auto write = [file](const void* data, size_t size) -> BOOL {
+        const BYTE* position = (const BYTE*)data;
+
+        // WriteFile() takes DWORD size
+        while (size > 0)
+        {
+            DWORD chunk = (DWORD)(std::min)(size, (size_t)1 << 30);
+            DWORD written = 0;
+
+            if (!WriteFile(file, position, chunk, &written, NULL) || written == 0)
+                return FALSE;
+
+            position += written;
+            size -= written;
+        }
+        return TRUE;
+    };
+
+    BOOL written = write(&header, sizeof(header)) &&
+                   write(m_folders.data(), m_folders.size() * sizeof(m_folders[0])) &&
+                   write(m_entries.data(), m_entries.size() * sizeof(m_entries[0])) &&
+                   write(m_names.data(), m_names.size() * sizeof(WCHAR));
+    CloseHandle(file);
+
+    if (written)
+        written = MoveFileEx(temporaryPath, snapshotPath, MOVEFILE_REPLACE_EXISTING);
+
+    if (!written)
+        DeleteFile(temporaryPath);
+
+    return written;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <string>
+
+#include "FileTable.h"
+
+
+
+// Folder state, that is checked before folder content is reused:
+// folder write time changes whenever an entry is added, removed or renamed
+struct FolderStamp
+{
+    ULONGLONG fileId = 0;
+    ULONGLONG lastWriteTime = 0;
+    DWORD volumeSerial = 0;
+    DWORD reserved = 0;
+};
+
+
+// Content of source and destination folders saved after the previous scan
+// File is mapped into memory and used read-only, so it can be shared
+// between scanning threads without locks
+//
+// Snapshot saves enumeration only: write time of a folder does not change
+// with changes deeper in its subtree, so each folder is opened and checked
+//
+// Note: changing file content does not change write time of its folder,
+//       so files of a reused folder keep size and times from the snapshot
+class ScanSnapshot
+{
+public:
+    // Identifies which of the synchronized folders path is relative to
+    enum class SIDE {
+        SOURCE,
+        DESTINATION
+    };
+
+    ScanSnapshot();
+    ~ScanSnapshot();
+
+    ScanSnapshot(const ScanSnapshot&) = delete;
+    ScanSnapshot& operator= (const ScanSnapshot&) = delete;
+
+    // Maps snapshot file; returns FALSE if file is missing,
+    // has another version or is damaged
+    BOOL load(const CString& snapshotPath);
+    void close();
+
+    // Fills entries only if folder is found and its stamp has not changed
+    BOOL getFolderEntries(SIDE side,
+                          const CString& relativePath,
+                          const FolderStamp& stamp,
+                          FileTable& entries) const;
+
+private:
+    friend class ScanSnapshotWriter;
+
+    // File layout: Header, FolderRecord[folderCount],
+    // EntryRecord[entryCount], WCHAR[namesLength]
+    // Paths and names are stored without terminating zero
+    static const DWORD SNAPSHOT_MAGIC = 0x504E5353; // "SSNP"
+    static const DWORD SNAPSHOT_VERSION = 2;
+
+    struct Header
+    {
+        DWORD magic;
+        DWORD version;
+        ULONGLONG folderCount;
+        ULONGLONG entryCount;
+        ULONGLONG namesLength;
+    };
+
+    struct FolderRecord
+    {
+        FolderStamp stamp;
+        DWORD side;
+        DWORD pathLength;
+        ULONGLONG pathOffset;
+        ULONGLONG firstEntry;
+        ULONGLONG entryCount;
+    };
+
+    struct EntryRecord
+    {
+        FileEntryInfo info;
+        ULONGLONG nameOffset;
+        DWORD nameLength;
+        DWORD reserved;
+    };
+
+    // Order of folder records in file: by side, then by path
+    static int compareFolders(DWORD firstSide, LPCWSTR firstPath, size_t firstLength,
+                              DWORD secondSide, LPCWSTR secondPath, size_t secondLength);
+
+    const FolderRecord* findFolder(SIDE side, const CString& relativePath) const;
+
+    HANDLE m_file;
+    HANDLE m_mapping;
+    const BYTE* m_view;
+
+    const Header* m_header;
+    const FolderRecord* m_folders;
+    const EntryRecord* m_entries;
+    LPCWSTR m_names;
+};
+
+
+// Collects folders during scan and writes them into a new snapshot file
+// addFolder() can be called from several scanning threads at once
+class ScanSnapshotWriter
+{
+public:
+    void addFolder(ScanSnapshot::SIDE side,
+                   const CString& relativePath,
+                   const FolderStamp& stamp,
+                   const FileTable& entries);
+
+    // Writes into temporary file first, so previous snapshot is replaced
+    // only by complete one; previous snapshot must not be mapped
+    BOOL save(const CString& snapshotPath);
+
+private:
+    std::mutex m_mutex;
+
+    std::vector <ScanSnapshot::FolderRecord> m_folders;
+    std::vector <ScanSnapshot::EntryRecord> m_entries;
+    std::wstring m_names;
+};
@@ -1,23 +1,46 @@
 #include "stdafx.h"
 #include "SyncManager.h"
+#include <ShlObj.h>
 
 #include "operations\CopyOperation.h"
 #include "operations\RemoveOperation.h"
 #include "operations\EmptyOperation.h"
 #include "operations\ReplaceOperation.h"
 #include "operations\CreateOperation.h"
+#include "FileCopy.h"
+
+
+
+// Operations found ahead of execution in scanAndSync()
+static const size_t OPERATION_STREAM_CAPACITY = 4096;
 
 
 
 SyncManager::SyncManager()
     : m_syncDirection(SYNC_DIRECTION::LEFT_TO_RIGHT),
       m_sourceFolder(_T("")),
-      m_destinationFolder(_T(""))
+      m_destinationFolder(_T("")),
+      m_statCallsAvoided(0),
+      m_foldersReused(0),
+      m_folderOpens(0),
+      m_hashCacheHits(0),
+      m_hashCacheMisses(0),
+      m_contentByMetadata(0),
+      m_contentByCache(0),
+      m_contentBySample(0),
+      m_contentByFullRead(0),
+      m_movesFound(0),
+      m_deltaFiles(0),
+      m_deltaBytesWritten(0),
+      m_deltaBytesSkipped(0),
+      m_stoppingWatch(false)
 {
 }
 
 SyncManager::~SyncManager()
 {
+    // Watchers call back into this object
+    stopWatching();
 }
 
 
@@ -59,16 +82,27 @@ SyncManager::SYNC_DIRECTION SyncManager::getSyncDirection() const
 void SyncManager::setOptions(const SyncManagerOptions& options)
 {
     m_options = options;
+    setRateLimits(options.bytesPerSecond, options.operationsPerSecond);
 }
 
 SyncManagerOptions SyncManager::getOptions() const
 {
-    return m_options;
+    SyncManagerOptions options = m_options;
+    options.bytesPerSecond = m_byteLimit.getRate();
+    options.operationsPerSecond = m_operationLimit.getRate();
+    return options;
+}
+
+void SyncManager::setRateLimits(ULONGLONG bytesPerSecond, ULONGLONG operationsPerSecond)
+{
+    m_byteLimit.setRate(bytesPerSecond);
+    m_operationLimit.setRate(operationsPerSecond);
 }
 
 void SyncManager::setComparisonParameters(const FileComparisonParameters& params)
 {
     m_compareParameters = params;
+    m_fileComparator = FileComparator(params);
 }
 
 FileComparisonParameters SyncManager::getComparisonParameters() const
@@ -90,12 +124,6 @@ BOOL SyncManager::isFileInDestinationFolder(const FileProperties& file) const
     return parentFolder.Find(getDestinationFolder()) == 0;
 }
 
-BOOL SyncManager::isFileInFileSet(const FileProperties& file,
-                                const FileSet &files) const
-{
-    return files.find(file) != files.end();
-}
-
 CString SyncManager::getFileRelativePath(const FileProperties& file,
                                          BOOL withName) const
 {
@@ -110,40 +138,155 @@ BOOL SyncManager::scan(ScanCallback* callback)
 {
     clearOperationQueue();
 
-    BOOL sourceExists = folderExists(getSourceFolder());
-    BOOL destinationExists = folderExists(getDestinationFolder());
-
-    if (!sourceExists || !destinationExists)
+    if (!canSync())
         return FALSE;
 
-    if (getSourceFolder() == getDestinationFolder())
+    scanTree(callback, m_syncOperations);
+
+    return TRUE;
+}
+
+void SyncManager::sync(SyncCallback* callback)
+{
+    resetSyncStatistics();
+    executeOperations(m_syncOperations, callback);
+    clearOperationQueue();
+}
+
+SyncManager::OperationQueue SyncManager::getOperationQueue()
+{
+    return m_syncOperations;
+}
+
+BOOL SyncManager::scanAndSync(ScanCallback* scanCallback, SyncCallback* syncCallback)
+{
+    clearOperationQueue();
+
+    if (!canSync())
         return FALSE;
 
-    if (getSyncDirection() == SYNC_DIRECTION::RIGHT_TO_LEFT)
-        scanFolders(getDestinationFolder(), getSourceFolder(), callback);
-    else
-        scanFolders(getSourceFolder(), getDestinationFolder(), callback);
+    resetSyncStatistics();
+    m_operationStream = std::make_unique<OperationStream>(OPERATION_STREAM_CAPACITY);
+
+    std::thread executor([this, syncCallback]() {
+        executeOperationStream(syncCallback);
+    });
+
+    // Stays empty, as operations go to the stream
+    OperationQueue operations;
+    scanTree(scanCallback, operations);
+
+    m_operationStream->close();
+    executor.join();
+    m_operationStream.reset();
 
     return TRUE;
 }
 
-void SyncManager::sync(SyncCallback* callback)
+void SyncManager::scanTree(ScanCallback* callback, OperationQueue& operations)
 {
-    for (SyncOperation::ptr& operation: m_syncOperations)
+    m_statCallsAvoided = 0;
+    m_foldersReused = 0;
+    m_folderOpens = 0;
+    m_hashCacheHits = 0;
+    m_hashCacheMisses = 0;
+    m_contentByMetadata = 0;
+    m_contentByCache = 0;
+    m_contentBySample = 0;
+    m_contentByFullRead = 0;
+    m_movesFound = 0;
+
+    if (USE_SCAN_SNAPSHOT)
     {
-        if (operation && !operation->isForbidden())
-        {
-            (*callback)(operation);
-            operation->execute();
-        }
+        m_previousSnapshot = std::make_unique<ScanSnapshot>();
+        if (!m_previousSnapshot->load(getPairDataFilePath(_T(".snapshot"))))
+            m_previousSnapshot.reset();
+
+        m_snapshotWriter = std::make_unique<ScanSnapshotWriter>();
     }
 
-    clearOperationQueue();
+    std::vector<CString> rootFolder(1, CString());
+    planFolders(rootFolder, TRUE, callback, operations);
+
+    if (m_snapshotWriter)
+    {
+        // Previous snapshot is unmapped, so that its file can be replaced
+        m_previousSnapshot.reset();
+        m_snapshotWriter->save(getPairDataFilePath(_T(".snapshot")));
+        m_snapshotWriter.reset();
+    }
 }
 
-SyncManager::OperationQueue SyncManager::getOperationQueue()
+BOOL SyncManager::startWatching(const WatchCallback& callback)
 {
-    return m_syncOperations;
+    stopWatching();
+
+    if (!canSync())
+        return FALSE;
+
+    m_watchCallback = callback;
+
+    auto onChanges = [this](const FolderChanges& changes) {
+        syncChanges(changes);
+    };
+    DWORD delay = getOptions().watchDelay;
+
+    m_sourceWatcher = std::make_unique<FolderWatcher>();
+    BOOL watching = m_sourceWatcher->start(getScanSourceFolder(), delay, onChanges);
+
+    if (watching && getSyncDirection() == SYNC_DIRECTION::BOTH)
+    {
+        m_destinationWatcher = std::make_unique<FolderWatcher>();
+        watching = m_destinationWatcher->start(getScanDestinationFolder(),
+                                               delay, onChanges);
+    }
+
+    if (!watching)
+        stopWatching();
+
+    return watching;
+}
+
+void SyncManager::stopWatching()
+{
+    // Watchers wait for their callback, running syncChanges()
+    m_stoppingWatch = true;
+
+    m_sourceWatcher.reset();
+    m_destinationWatcher.reset();
+    m_watchCallback = nullptr;
+
+    m_stoppingWatch = false;
+}
+
+BOOL SyncManager::isWatching() const
+{
+    return m_sourceWatcher != nullptr;
+}
+
+ScanStatistics SyncManager::getScanStatistics() const
+{
+    ScanStatistics statistics;
+    statistics.statCallsAvoided = m_statCallsAvoided;
+    statistics.foldersReused = m_foldersReused;
+    statistics.folderOpens = m_folderOpens;
+    statistics.hashCacheHits = m_hashCacheHits;
+    statistics.hashCacheMisses = m_hashCacheMisses;
+    statistics.contentByMetadata = m_contentByMetadata;
+    statistics.contentByCache = m_contentByCache;
+    statistics.contentBySample = m_contentBySample;
+    statistics.contentByFullRead = m_contentByFullRead;
+    statistics.movesFound = m_movesFound;
+    return statistics;
+}
+
+SyncStatistics SyncManager::getSyncStatistics() const
+{
+    SyncStatistics statistics;
+    statistics.deltaFiles = m_deltaFiles;
+    statistics.deltaBytesWritten = m_deltaBytesWritten;
+    statistics.deltaBytesSkipped = m_deltaBytesSkipped;
+    return statistics;
 }
 
 
@@ -156,106 +299,656 @@ BOOL SyncManager::folderExists(const CString& folder) const
     return (attributes & FILE_ATTRIBUTE_DIRECTORY);
 }
 
-BOOL SyncManager::fileMeetsRequirements(const FileProperties& file) const
+BOOL SyncManager::canSync() const
 {
-    SyncManagerOptions options = getOptions();
+    BOOL sourceExists = folderExists(getSourceFolder());
+    BOOL destinationExists = folderExists(getDestinationFolder());
+
+    if (!sourceExists || !destinationExists)
+        return FALSE;
+
+    return getSourceFolder() != getDestinationFolder();
+}
+
+CString SyncManager::getScanSourceFolder() const
+{
+    if (getSyncDirection() == SYNC_DIRECTION::RIGHT_TO_LEFT)
+        return getDestinationFolder();
+    else
+        return getSourceFolder();
+}
+
+CString SyncManager::getScanDestinationFolder() const
+{
+    if (getSyncDirection() == SYNC_DIRECTION::RIGHT_TO_LEFT)
+        return getSourceFolder();
+    else
+        return getDestinationFolder();
+}
+
+BOOL SyncManager::fileMeetsRequirements(DWORD attributes) const
+{
+    const SyncManagerOptions& options = m_options;
     BOOL result = TRUE;
 
-    if (!options.syncHiddenFiles && file.isHidden())
+    if (!options.syncHiddenFiles && (attributes & FILE_ATTRIBUTE_HIDDEN))
         result = FALSE;
 
-    if (!options.recursive && file.isFolder())
+    if (!options.recursive && (attributes & FILE_ATTRIBUTE_DIRECTORY))
         result = FALSE;
 
     return result;
 }
 
-SyncManager::FileSet SyncManager::getFilesFromFolder(const CString& folder) const
+SyncManager::FileList SyncManager::getFilesFromFolder(const PathNode::ptr& folder) const
+{
+    FolderContent content;
+    readFolder(folder, content);
+
+    FileList files;
+    files.reserve(content.files.size());
+
+    for (FileTable::Handle file : content.files)
+        files.push_back(content.table.makeFileProperties(file, folder));
+
+    return files;
+}
+
+void SyncManager::readFolder(const PathNode::ptr& folder, FolderContent& content) const
 {
-    FileSet files;
+    content.folder = folder;
+    content.table.clear();
+    content.files.clear();
+
+    CString folderPath = folder->getFullPath();
+
+    // The same handle is used both to read folder stamp and to enumerate
+    HANDLE folderHandle = CreateFile(folderPath,
+                                     FILE_LIST_DIRECTORY | FILE_READ_ATTRIBUTES,
+                                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                     NULL,
+                                     OPEN_EXISTING,
+                                     FILE_FLAG_BACKUP_SEMANTICS,
+                                     NULL);
+    ++m_folderOpens;
+
+    if (folderHandle == INVALID_HANDLE_VALUE)
+        return;
+
+    FolderStamp stamp;
+    FileTable& entries = content.table;
+
+    ScanSnapshot::SIDE side;
+    CString relativePath;
+
+    // Volume of the stamp identifies files in HashCache
+    BOOL hasStamp = readFolderStamp(folderHandle, stamp);
+
+    BOOL useSnapshot = m_snapshotWriter && hasStamp &&
+                       getSnapshotLocation(folderPath, side, relativePath);
+
+    BOOL reused = useSnapshot && m_previousSnapshot &&
+                  m_previousSnapshot->getFolderEntries(side, relativePath,
+                                                       stamp, entries);
+    if (reused)
+        ++m_foldersReused;
+    else
+    {
+        // Damaged snapshot may leave part of entries
+        entries.clear();
+        enumerateFolder(folderHandle, stamp.volumeSerial, entries);
+        m_statCallsAvoided += entries.size();
+    }
 
-    CFileFind fileFinder;
-    BOOL hasFiles = fileFinder.FindFile(folder + CString("\\*.*"));
+    CloseHandle(folderHandle);
 
-    while (hasFiles)
+    // Snapshot keeps every entry, as options may differ on the next scan
+    if (useSnapshot)
+        m_snapshotWriter->addFolder(side, relativePath, stamp, entries);
+
+    content.files.reserve(entries.size());
+    for (FileTable::Handle entry = 0; entry < entries.size(); ++entry)
     {
-        hasFiles = fileFinder.FindNextFile();
-        
-        // Ignore "." and ".."
-        if (!fileFinder.IsDots())
+        BOOL isStaging = FileCopy::isStagingFile(entries.getName(entry),
+                                                 entries.getNameLength(entry));
+        if (!isStaging && fileMeetsRequirements(entries.getAttributes(entry)))
+            content.files.push_back(entry);
+    }
+
+    entries.sort(content.files);
+}
+
+BOOL SyncManager::readFolderStamp(HANDLE folderHandle, FolderStamp& stamp)
+{
+    BY_HANDLE_FILE_INFORMATION information;
+    if (!GetFileInformationByHandle(folderHandle, &information))
+        return FALSE;
+
+    stamp.volumeSerial = information.dwVolumeSerialNumber;
+    stamp.fileId = ((ULONGLONG)information.nFileIndexHigh << 32) |
+                   information.nFileIndexLow;
+    stamp.lastWriteTime =
+        ((ULONGLONG)information.ftLastWriteTime.dwHighDateTime << 32) |
+        information.ftLastWriteTime.dwLowDateTime;
+
+    return TRUE;
+}
+
+void SyncManager::enumerateFolder(HANDLE folderHandle,
+                                  DWORD volumeSerial,
+                                  FileTable& entries)
+{
+    // Every call fills the buffer with as many entries as fit into it;
+    // ULONGLONG keeps records aligned
+    const DWORD BUFFER_SIZE = 64 * 1024;
+    std::vector<ULONGLONG> buffer(BUFFER_SIZE / sizeof(ULONGLONG));
+
+    while (GetFileInformationByHandleEx(folderHandle,
+                                        FileIdBothDirectoryInfo,
+                                        buffer.data(),
+                                        BUFFER_SIZE))
+    {
+        const BYTE* position = (const BYTE*)buffer.data();
+
+        for (;;)
         {
-            CFileStatus fileProperties;
-            CFile::GetStatus(fileFinder.GetFilePath(), fileProperties);
+            auto record = (const FILE_ID_BOTH_DIR_INFO*)position;
+
+            LPCWSTR name = record->FileName;
+            size_t nameLength = record->FileNameLength / sizeof(WCHAR);
 
-            FileProperties file(fileProperties);
+            // Ignore "." and ".."
+            BOOL isDots = (nameLength == 1 && name[0] == '.') ||
+                          (nameLength == 2 && name[0] == '.' && name[1] == '.');
+            if (!isDots)
+            {
+                FileEntryInfo info;
+                info.size = record->EndOfFile.QuadPart;
+                info.creationTime = record->CreationTime.QuadPart;
+                info.lastAccessTime = record->LastAccessTime.QuadPart;
+                info.lastWriteTime = record->LastWriteTime.QuadPart;
+                info.fileId = record->FileId.QuadPart;
+                info.attributes = record->FileAttributes;
+                info.volumeSerial = volumeSerial;
+
+                entries.add(name, nameLength, info);
+            }
 
-            if (fileMeetsRequirements(file))
-                files.insert(file);
+            if (record->NextEntryOffset == 0)
+                break;
+            position += record->NextEntryOffset;
         }
     }
+}
 
-    fileFinder.Close();
-    return files;
+BOOL SyncManager::getSnapshotLocation(const CString& folder,
+                                      ScanSnapshot::SIDE& side,
+                                      CString& relativePath) const
+{
+    auto isInside = [&folder](const CString& root) -> BOOL {
+        int rootLength = root.GetLength();
+
+        if (folder.GetLength() < rootLength)
+            return FALSE;
+        if (_tcsnicmp(folder, root, rootLength) != 0)
+            return FALSE;
+
+        return folder.GetLength() == rootLength || folder[rootLength] == '\\';
+    };
+
+    if (isInside(getSourceFolder()))
+    {
+        side = ScanSnapshot::SIDE::SOURCE;
+        relativePath = folder.Mid(getSourceFolder().GetLength());
+        return TRUE;
+    }
+
+    if (isInside(getDestinationFolder()))
+    {
+        side = ScanSnapshot::SIDE::DESTINATION;
+        relativePath = folder.Mid(getDestinationFolder().GetLength());
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+CString SyncManager::getPairDataFilePath(LPCTSTR extension) const
+{
+    TCHAR appDataPath[MAX_PATH];
+    HRESULT result = SHGetFolderPath(NULL, CSIDL_LOCAL_APPDATA, NULL, 0,
+                                     appDataPath);
+    if (!SUCCEEDED(result))
+        return CString();
+
+    CString dataFolder = CString(appDataPath) + _T("\\SimpleSync");
+    CreateDirectory(dataFolder, NULL);
+
+    // FNV-1a of both folders, so that every pair has its own files
+    CString pair = getSourceFolder() + _T("|") + getDestinationFolder();
+    pair.MakeLower();
+
+    ULONGLONG hash = 14695981039346656037ULL;
+    for (int i = 0; i < pair.GetLength(); ++i)
+    {
+        hash ^= (ULONGLONG)pair[i];
+        hash *= 1099511628211ULL;
+    }
+
+    CString fileName;
+    fileName.Format(_T("\\%016llx%s"), hash, extension);
+
+    return dataFolder + fileName;
+}
+
+void SyncManager::readFolderTree(const PathNode::ptr& folder, FolderTree& tree) const
+{
+    tree.files = getFilesFromFolder(folder);
+    tree.subfolders.resize(tree.files.size());
+
+    for (size_t i = 0; i < tree.files.size(); ++i)
+    {
+        if (tree.files[i].isFolder())
+        {
+            tree.subfolders[i] = std::make_unique<FolderTree>();
+            readFolderTree(tree.files[i].makePathNode(), *tree.subfolders[i]);
+        }
+    }
 }
 
-void SyncManager::scanFolders(const CString& source,
-                              const CString& destination,
-                              ScanCallback* callback)
+void SyncManager::scanFolders(const PathNode::ptr& source,
+                              const PathNode::ptr& destination,
+                              ScanCallback* callback,
+                              ScanNode& node,
+                              BOOL scanSubfolders)
 {
+    // Result of abandoned scan is not executed
+    if (m_stoppingWatch)
+        return;
+
+    CString sourcePath = source->getFullPath();
+    CString destinationPath = destination->getFullPath();
+
     // TODO: pass relative, not absolute path
-    (*callback)(source);
+    if (callback)
+        (*callback)(sourcePath);
+
+    FolderContent sourceContent;
+    FolderContent destinationContent;
+    readFolder(source, sourceContent);
+    readFolder(destination, destinationContent);
+
+    const FileTable& sourceTable = sourceContent.table;
+    const FileTable& destinationTable = destinationContent.table;
+
+    // Files, that exist only in destination, are handled after
+    // the files from source, in the same order sequential scan had
+    FileTable::Handles destinationOnlyFiles;
 
-    FileSet sourceFiles = getFilesFromFolder(source);
-    FileSet destinationFiles = getFilesFromFolder(destination);
+    auto sourceIt = sourceContent.files.cbegin();
+    auto destinationIt = destinationContent.files.cbegin();
 
-    for (auto fileIt = sourceFiles.cbegin(); fileIt != sourceFiles.cend(); )
+    // Names are merged within tables; FileProperties are made
+    // only for entries, that get into operations
+    while (sourceIt != sourceContent.files.cend())
     {
-        const FileProperties& file = *fileIt;
+        int comparison = -1;
+        if (destinationIt != destinationContent.files.cend())
+            comparison = sourceTable.compareNames(*sourceIt, destinationTable, *destinationIt);
 
-        if (!isFileInFileSet(file, destinationFiles))
-            manageCopyOperation(file, destination);
+        if (comparison > 0)
+        {
+            destinationOnlyFiles.push_back(*destinationIt);
+            ++destinationIt;
+            continue;
+        }
+
+        FileProperties file = sourceTable.makeFileProperties(*sourceIt, source);
+
+        if (comparison < 0)
+            manageCopyOperation(file, destinationPath, node);
         else
         {
-            auto sameFileIt = destinationFiles.find(file);
-            const FileProperties& sameFile = *sameFileIt;
-            
+            FileProperties sameFile = destinationTable.makeFileProperties(*destinationIt,
+                                                                          destination);
+
             if (file.isFolder())
             {
-                enqueueOperation(new EmptyOperation(file, sameFile));
-                scanFolders(file.getFullPath(), sameFile.getFullPath(), callback);
+                enqueueOperation(new EmptyOperation(file, sameFile), node);
+
+                if (scanSubfolders)
+                {
+                    auto subfolder = std::make_unique<ScanNode>();
+                    ScanNode* subfolderNode = subfolder.get();
+                    node.subfolders.emplace_back(node.operations.size(),
+                                                 std::move(subfolder));
+
+                    PathNode::ptr subfolderSource = file.makePathNode();
+                    PathNode::ptr subfolderDestination = sameFile.makePathNode();
+                    m_scanPool->submit([=]() {
+                        scanFolders(subfolderSource, subfolderDestination,
+                                    callback, *subfolderNode, TRUE);
+                    });
+                }
+            }
+            else if (needsContentComparison(file, sameFile))
+            {
+                // Files are read to be compared, so comparison runs as
+                // a separate task, placed into the queue like a subfolder
+                auto comparison = std::make_unique<ScanNode>();
+                ScanNode* comparisonNode = comparison.get();
+                node.subfolders.emplace_back(node.operations.size(),
+                                             std::move(comparison));
+
+                m_scanPool->submit([=]() {
+                    manageReplaceOperation(file, sameFile, *comparisonNode);
+                });
             }
             else
-                manageReplaceOperation(file, sameFile);
+                manageReplaceOperation(file, sameFile, node);
 
-            destinationFiles.erase(sameFileIt);
+            ++destinationIt;
         }
 
-        fileIt = sourceFiles.erase(fileIt);
+        ++sourceIt;
+    }
+
+    for (; destinationIt != destinationContent.files.cend(); ++destinationIt)
+        destinationOnlyFiles.push_back(*destinationIt);
+
+
+    for (FileTable::Handle handle : destinationOnlyFiles)
+    {
+        FileProperties file = destinationTable.makeFileProperties(handle, destination);
+
+        if (getSyncDirection() == SYNC_DIRECTION::BOTH)
+            manageCopyOperation(file, sourcePath, node);
+        else
+            manageRemoveOperation(file, node);
+    }
+}
+
+
+
+void SyncManager::planFolders(const std::vector<CString>& relativeFolders,
+                              BOOL scanSubfolders,
+                              ScanCallback* callback,
+                              OperationQueue& operations)
+{
+    CString source = getScanSourceFolder();
+    CString destination = getScanDestinationFolder();
+
+    // Byte-by-byte comparison does not rely on hashes
+    if (m_compareParameters.m_compareContent && !m_compareParameters.m_compareBytes)
+    {
+        // Missing or damaged cache just leaves it empty
+        m_hashCache = std::make_unique<HashCache>();
+        m_hashCache->load(getPairDataFilePath(_T(".hashes")));
+    }
+
+    if (m_compareParameters.m_compareContent)
+        m_contentComparator = std::make_unique<ContentComparator>(m_compareParameters,
+                                                                  m_hashCache.get());
+
+    m_scanPool = std::make_unique<WorkStealingPool>(getOptions().scanThreads);
+    ScanNode root;
+
+    for (const CString& folder : relativeFolders)
+    {
+        auto folderNode = std::make_unique<ScanNode>();
+        ScanNode* node = folderNode.get();
+        root.subfolders.emplace_back(0, std::move(folderNode));
+
+        PathNode::ptr folderSource = PathNode::makeRoot(source + folder);
+        PathNode::ptr folderDestination = PathNode::makeRoot(destination + folder);
+        m_scanPool->submit([=]() {
+            scanFolders(folderSource, folderDestination,
+                        callback, *node, scanSubfolders);
+        });
+    }
+
+    m_scanPool->wait();
+    m_scanPool.reset();
+
+    // Content comparator is still needed to confirm moves
+    mergeScanResults(root, operations);
+    detectMoves(operations);
+
+    if (m_contentComparator)
+    {
+        m_contentByMetadata += m_contentComparator->getMetadataDecisions();
+        m_contentByCache += m_contentComparator->getCacheDecisions();
+        m_contentBySample += m_contentComparator->getSampleDecisions();
+        m_contentByFullRead += m_contentComparator->getFullDecisions();
+        m_contentComparator.reset();
+    }
+
+    if (m_hashCache)
+    {
+        m_hashCacheHits += m_hashCache->getHits();
+        m_hashCacheMisses += m_hashCache->getMisses();
+
+        m_hashCache->save(getPairDataFilePath(_T(".hashes")));
+        m_hashCache.reset();
     }
+}
+
+void SyncManager::mergeScanResults(ScanNode& node, OperationQueue& operations)
+{
+    size_t position = 0;
+
+    for (auto& subfolder : node.subfolders)
+    {
+        for (; position < subfolder.first; ++position)
+            operations.push_back(node.operations[position]);
+
+        mergeScanResults(*subfolder.second, operations);
+    }
+
+    for (; position < node.operations.size(); ++position)
+        operations.push_back(node.operations[position]);
+}
+
+void SyncManager::detectMoves(OperationQueue& operations)
+{
+    BOOL removesFiles = getOptions().deleteFiles &&
+                        getSyncDirection() != SYNC_DIRECTION::BOTH;
+    if (!removesFiles)
+        return;
+
+    MoveDetector detector(m_compareParameters, m_contentComparator.get());
+    m_movesFound += detector.detectMoves(operations);
+}
 
+void SyncManager::executeOperations(OperationQueue& operations,
+                                    SyncCallback* callback)
+{
+    auto position = operations.begin();
+
+    // Operations, already given to executor, are skipped by executeOperation()
+    executeOperationSource([&](SyncOperation::ptr& operation) -> BOOL {
+        if (position == operations.end() || m_stoppingWatch)
+            return FALSE;
+
+        operation = *position++;
+        return TRUE;
+    }, callback);
+}
 
-    for (auto fileIt = destinationFiles.cbegin(); fileIt != destinationFiles.cend();)
+void SyncManager::executeOperation(SyncOperation::ptr& operation,
+                                   SyncCallback* callback)
+{
+    if (operation && !operation->isForbidden() && !m_stoppingWatch)
     {
-        const FileProperties& file = *fileIt;
+        if (callback)
+        {
+            std::lock_guard<std::mutex> lock(m_syncCallbackMutex);
+            (*callback)(operation);
+        }
+
+        SyncManagerOptions options = getOptions();
 
-        if (!isFileInFileSet(file, sourceFiles))
+        ReplaceOperation* replace = NULL;
+        if (operation->getType() == SyncOperation::TYPE::REPLACE)
         {
-            if (getSyncDirection() == SYNC_DIRECTION::BOTH)
-                manageCopyOperation(file, source);
-            else
-                manageRemoveOperation(file);
+            replace = static_cast<ReplaceOperation*>(operation.get());
+            replace->setDeltaThreshold(options.deltaThreshold);
         }
 
-        fileIt = destinationFiles.erase(fileIt);
+        // Data is charged block by block while it is written
+        operation->setByteLimit(&m_byteLimit);
+
+        // Ambiguous replacement does nothing, so it is not limited
+        BOOL isAmbiguous = replace && replace->isAmbiguous();
+        if (!isAmbiguous)
+            m_operationLimit.acquire(operation->getOperationCount());
+
+        // Background mode belongs to thread, executing threads may be
+        // pool workers, so it is entered for each operation
+        BOOL isBackground = options.backgroundMode &&
+                            SetThreadPriority(GetCurrentThread(),
+                                              THREAD_MODE_BACKGROUND_BEGIN);
+
+        BOOL executed = operation->execute();
+
+        if (executed && operation->getType() == SyncOperation::TYPE::CREATE)
+        {
+            std::lock_guard<std::mutex> lock(m_createdFoldersMutex);
+            m_createdFolders.push_back(operation);
+        }
+
+        if (isBackground)
+            SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+
+        if (replace && replace->isDeltaCopied())
+        {
+            DeltaCopy::Result result = replace->getDeltaResult();
+
+            ++m_deltaFiles;
+            m_deltaBytesWritten += result.bytesWritten;
+            m_deltaBytesSkipped += result.bytesSkipped;
+        }
     }
 }
 
+void SyncManager::resetSyncStatistics()
+{
+    m_deltaFiles = 0;
+    m_deltaBytesWritten = 0;
+    m_deltaBytesSkipped = 0;
+}
+
+void SyncManager::executeOperationStream(SyncCallback* callback)
+{
+    // Scan produces operations in queue order, as executor requires
+    executeOperationSource([this](SyncOperation::ptr& operation) {
+        return m_operationStream->pop(operation);
+    }, callback);
+}
+
+void SyncManager::executeOperationSource(const OperationSource& nextOperation,
+                                         SyncCallback* callback)
+{
+    SyncOperation::ptr operation;
+
+    UINT threadCount = getOptions().syncThreads;
+    if (threadCount == 1)
+    {
+        CopyBatcher batcher([this, callback](const SyncOperation::ptr& batched) {
+            SyncOperation::ptr next = batched;
+            executeOperation(next, callback);
+        });
+
+        while (nextOperation(operation))
+            batcher.add(operation);
+        batcher.flush();
 
+        restoreFolderTimes();
+        return;
+    }
+
+    OperationExecutor executor(threadCount, [this, callback](SyncOperation::ptr& next) {
+        executeOperation(next, callback);
+    });
+
+    CopyBatcher batcher([&executor](const SyncOperation::ptr& batched) {
+        if (batched)
+            executor.add(batched);
+    });
+
+    while (nextOperation(operation))
+        batcher.add(operation);
+    batcher.flush();
+
+    executor.wait();
 
-void SyncManager::enqueueOperation(SyncOperation* operation)
+    restoreFolderTimes();
+}
+
+void SyncManager::restoreFolderTimes()
 {
-    if (operation)
-        m_syncOperations.push_back(SyncOperation::ptr(operation));
+    std::lock_guard<std::mutex> lock(m_createdFoldersMutex);
+
+    for (const SyncOperation::ptr& operation : m_createdFolders)
+        static_cast<const CreateFolderOperation*>(operation.get())->restoreTimes();
+
+    m_createdFolders.clear();
+}
+
+void SyncManager::syncChanges(const FolderChanges& changes)
+{
+    std::lock_guard<std::mutex> lock(m_watchMutex);
+
+    CString source = getScanSourceFolder();
+    CString destination = getScanDestinationFolder();
+
+    std::vector<CString> folders;
+
+    // Lost changes may be anywhere, so the whole tree is scanned
+    BOOL scanSubfolders = changes.changesLost;
+    if (scanSubfolders)
+        folders.push_back(CString());
+
+    for (CString folder : changes.folders)
+    {
+        if (scanSubfolders)
+            break;
+
+        if (!getOptions().recursive)
+            folder.Empty();
+
+        // New or removed folder is handled by the nearest parent folder,
+        // that exists on both sides: its subfolders are copied or removed
+        // as a whole
+        while (!folder.IsEmpty() &&
+               !(folderExists(source + folder) && folderExists(destination + folder)))
+            folder = folder.Left(folder.ReverseFind('\\'));
+
+        if (std::find(folders.begin(), folders.end(), folder) == folders.end())
+            folders.push_back(folder);
+    }
+
+    OperationQueue operations;
+
+    planFolders(folders, scanSubfolders, NULL, operations);
+    if (m_stoppingWatch)
+        return;
+
+    executeOperations(operations, NULL);
+
+    if (m_watchCallback)
+        m_watchCallback(operations);
+}
+
+void SyncManager::enqueueOperation(SyncOperation* operation, ScanNode& node)
+{
+    if (!operation)
+        return;
+
+    if (m_operationStream)
+        m_operationStream->push(SyncOperation::ptr(operation));
+    else
+        node.operations.push_back(SyncOperation::ptr(operation));
 }
 
 void SyncManager::clearOperationQueue()
@@ -264,37 +957,66 @@ void SyncManager::clearOperationQueue()
 }
 
 void SyncManager::manageCopyOperation(const FileProperties& fileToCopy,
-                                      const CString& destinationFolder)
+                                      const CString& destinationFolder,
+                                      ScanNode& node)
 {
     if (fileToCopy.isFolder())
     {
-        BOOL isEmpty = PathIsDirectoryEmpty(fileToCopy.getFullPath());
-        if (isEmpty && !getOptions().createEmptyFolders)
-            return;
-
-        CString folderToCreate = destinationFolder + "\\" + fileToCopy.getFileName();
-        enqueueOperation(new CreateFolderOperation(fileToCopy, folderToCreate));
-
-        FileSet files = getFilesFromFolder(fileToCopy.getFullPath());
+        FolderTree content;
+        readFolderTree(fileToCopy.makePathNode(), content);
 
-        // Recursively copy files and subfolders
-        for (const auto& file : files)
-            manageCopyOperation(file, folderToCreate);
+        manageFolderCopy(fileToCopy, content, destinationFolder, node);
     }
     else
     {
         if (getOptions().copyMissingFiles)
-            enqueueOperation(new CopyOperation(fileToCopy, destinationFolder));
+            enqueueOperation(new CopyOperation(fileToCopy, destinationFolder),
+                             node);
     }
 }
 
+void SyncManager::manageFolderCopy(const FileProperties& folderToCopy,
+                                   const FolderTree& content,
+                                   const CString& destinationFolder,
+                                   ScanNode& node)
+{
+    // Files, that are not synchronized (e.g. hidden), do not count
+    BOOL isEmpty = content.files.empty();
+    if (isEmpty && !getOptions().createEmptyFolders)
+        return;
+
+    CString folderToCreate = destinationFolder + "\\" + folderToCopy.getFileName();
+    enqueueOperation(new CreateFolderOperation(folderToCopy, folderToCreate),
+                     node);
+
+    // Recursively copy files and subfolders
+    for (size_t i = 0; i < content.files.size(); ++i)
+    {
+        const FileProperties& file = content.files[i];
+
+        if (file.isFolder())
+            manageFolderCopy(file, *content.subfolders[i], folderToCreate, node);
+        else
+            manageCopyOperation(file, folderToCreate, node);
+    }
+}
+
+BOOL SyncManager::needsContentComparison(const FileProperties& firstFile,
+                                         const FileProperties& secondFile) const
+{
+    return m_contentComparator &&
+           !m_contentComparator->decidesByMetadata(firstFile, secondFile);
+}
+
 void SyncManager::manageReplaceOperation(const FileProperties& originalFile,
-                                         const FileProperties& fileToReplace)
+                                         const FileProperties& fileToReplace,
+                                         ScanNode& node)
 {
     using RESULT = FileProperties::COMPARISON_RESULT;
 
-    RESULT compareResult = originalFile.compareTo(fileToReplace,
-                                                  getComparisonParameters());
+    RESULT compareResult = m_fileComparator.compare(originalFile,
+                                                    fileToReplace,
+                                                    m_contentComparator.get());
     SyncOperation* op = NULL;
 
     // Find out ambiguity and direction
@@ -316,20 +1038,40 @@ void SyncManager::manageReplaceOperation(const FileProperties& originalFile,
         op = new EmptyOperation(originalFile, fileToReplace);
         break;
     }
-    enqueueOperation(op);
+    enqueueOperation(op, node);
 }
 
-void SyncManager::manageRemoveOperation(const FileProperties& fileToRemove)
+void SyncManager::manageRemoveOperation(const FileProperties& fileToRemove,
+                                        ScanNode& node)
 {
     if (fileToRemove.isFolder())
     {
-        FileSet files = getFilesFromFolder(fileToRemove.getFullPath());
+        FolderTree content;
+        readFolderTree(fileToRemove.makePathNode(), content);
 
-        // Recursively remove files and subfolders
-        for (const auto& file : files)
-            manageRemoveOperation(file);
+        manageFolderRemove(fileToRemove, content, node);
+        return;
+    }
+
+    if (getOptions().deleteFiles)
+        enqueueOperation(new RemoveOperation(fileToRemove), node);
+}
+
+void SyncManager::manageFolderRemove(const FileProperties& folderToRemove,
+                                     const FolderTree& content,
+                                     ScanNode& node)
+{
+    // Recursively remove files and subfolders
+    for (size_t i = 0; i < content.files.size(); ++i)
+    {
+        const FileProperties& file = content.files[i];
+
+        if (file.isFolder())
+            manageFolderRemove(file, *content.subfolders[i], node);
+        else
+            manageRemoveOperation(file, node);
     }
 
     if (getOptions().deleteFiles)
-        enqueueOperation(new RemoveOperation(fileToRemove));
+        enqueueOperation(new RemoveOperation(folderToRemove), node);
 }
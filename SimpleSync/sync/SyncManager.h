@@ -1,7 +1,11 @@
 #pragma once
 
-#include <set>
 #include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
 #include <algorithm>
 #include <functional>
 
@@ -10,8 +14,21 @@
 #include "operations/RemoveOperation.h"
 #include "operations/EmptyOperation.h"
 #include "operations/CreateOperation.h"
+#include "operations/MoveOperation.h"
 
 #include "FileProperties.h"
+#include "FileTable.h"
+#include "ScanSnapshot.h"
+#include "HashCache.h"
+#include "ContentComparator.h"
+#include "FileComparator.h"
+#include "FolderWatcher.h"
+#include "OperationStream.h"
+#include "OperationExecutor.h"
+#include "CopyBatcher.h"
+#include "MoveDetector.h"
+#include "WorkStealingPool.h"
+#include "TokenBucket.h"
 
 
 
@@ -22,6 +39,79 @@ struct SyncManagerOptions
     BOOL createEmptyFolders = FALSE;
     BOOL syncHiddenFiles = FALSE;
     BOOL copyMissingFiles = TRUE;
+
+    // Number of threads that scan folders; 0 - one per hardware thread
+    UINT scanThreads = 0;
+
+    // Number of threads that execute operations; 0 - one per hardware thread
+    // 1 - operations are executed one by one in queue order,
+    // otherwise independent operations run at once, see OperationExecutor
+    UINT syncThreads = 4;
+
+    // Replaced files of at least this size get only changed blocks written,
+    // see DeltaCopy; 0 - files are always copied whole
+    ULONGLONG deltaThreshold = 64 * 1024 * 1024;
+
+    // Limits of sync speed, may be changed while sync runs,
+    // see SyncManager::setRateLimits(); 0 - no limit
+    // Data is charged block by block while it is written, so a large file
+    // is copied at the limited speed too; cloned files write no data
+    ULONGLONG bytesPerSecond = 0;
+    ULONGLONG operationsPerSecond = 0;
+
+    // Operations are executed with background CPU, I/O and memory priority,
+    // so that other programs using the same disks are not slowed down
+    BOOL backgroundMode = FALSE;
+
+    // Sync without preview: operations are executed while scan goes on,
+    // see SyncManager::scanAndSync()
+    BOOL syncWithoutPreview = FALSE;
+
+    // Watch mode: changes are synchronized once no new change
+    // has come during this time, in milliseconds
+    UINT watchDelay = 1000;
+};
+
+
+// Counters collected during the last call of SyncManager::scan()
+struct ScanStatistics
+{
+    // Files, whose properties were taken from directory enumeration
+    // instead of separate CFile::GetStatus() call
+    ULONGLONG statCallsAvoided = 0;
+
+    // Folders, whose content was taken from the previous scan snapshot;
+    // stays 0 while the snapshot is disabled, see SyncManager::USE_SCAN_SNAPSHOT
+    ULONGLONG foldersReused = 0;
+
+    // Folders opened for enumeration; every folder is opened once per scan
+    ULONGLONG folderOpens = 0;
+
+    // Content hashes taken from HashCache and hashes, that had to be
+    // computed, see FileComparisonParameters::m_compareContent
+    ULONGLONG hashCacheHits = 0;
+    ULONGLONG hashCacheMisses = 0;
+
+    // Pairs of files, whose content was compared, by the tier
+    // that decided, see ContentComparator
+    ULONGLONG contentByMetadata = 0;
+    ULONGLONG contentByCache = 0;
+    ULONGLONG contentBySample = 0;
+    ULONGLONG contentByFullRead = 0;
+
+    // Copies and removals, that were replaced by one move, see MoveDetector
+    ULONGLONG movesFound = 0;
+};
+
+
+// Counters collected during the last call of SyncManager::sync()
+// or scanAndSync(); watch mode keeps adding to them
+struct SyncStatistics
+{
+    // Replaced files, that were written partially, see DeltaCopy
+    ULONGLONG deltaFiles = 0;
+    ULONGLONG deltaBytesWritten = 0;
+    ULONGLONG deltaBytesSkipped = 0;
 };
 
 
@@ -29,20 +119,27 @@ struct SyncManagerOptions
 class SyncManager
 {
 public:
-    // Uses FileProperties::operator< to store files in certain order
+    // Folder content, sorted once with FileProperties::operator<
     // see FileProperties::operator< declaration
-    using FileSet = std::set <FileProperties>;
+    using FileList = std::vector <FileProperties>;
 
     using OperationQueue = std::deque <SyncOperation::ptr>;
 
     // Called right before execution of SyncOperation
-    // argument - SyncOperation that is about to be executed
+    // argument - SyncOperation that is about to be executed; it may be
+    // a batch of several queued ones, see SyncOperation::getOperationCount()
     using SyncCallback = std::function <void (SyncOperation::ptr&)>;
 
     // Called before scanning folder
     // argument - folder
+    // Folders are scanned in parallel, so callback must be thread-safe
+    // May be NULL, if progress is not needed
     using ScanCallback = std::function <void (const CString&)>;
 
+    // Called on watcher thread after a batch of changes is synchronized
+    // argument - operations that were executed
+    using WatchCallback = std::function <void (const OperationQueue&)>;
+
     enum class SYNC_DIRECTION {
         LEFT_TO_RIGHT,
         BOTH,
@@ -63,6 +160,9 @@ public:
     void setOptions(const SyncManagerOptions& options);
     SyncManagerOptions getOptions() const;
 
+    // Unlike setOptions(), may be called while operations are executed
+    void setRateLimits(ULONGLONG bytesPerSecond, ULONGLONG operationsPerSecond);
+
     void setComparisonParameters(const FileComparisonParameters& params);
     FileComparisonParameters getComparisonParameters() const;
 
@@ -70,8 +170,6 @@ public:
     // or directly there
     BOOL isFileInSourceFolder(const FileProperties& file) const;
     BOOL isFileInDestinationFolder(const FileProperties& file) const;
-    BOOL isFileInFileSet(const FileProperties& file,
-                         const FileSet& files) const;
 
     // Get file path, relatively to source/destination folder
     CString getFileRelativePath(const FileProperties& file,
@@ -84,27 +182,179 @@ public:
     void sync(SyncCallback* callback);
     OperationQueue getOperationQueue();
 
+    // Scans and synchronizes at once, without preview: operations are
+    // executed on a separate thread as soon as they are found
+    // Ambiguous operations are not executed
+    // Operation queue stays empty
+    BOOL scanAndSync(ScanCallback* scanCallback, SyncCallback* syncCallback);
+
+    ScanStatistics getScanStatistics() const;
+    SyncStatistics getSyncStatistics() const;
+
+public:
+    // Watch mode: folders are watched for changes and only changed folders
+    // are scanned and synchronized, without preview
+    // Folders, direction and options must not change while watching
+    BOOL startWatching(const WatchCallback& callback);
+
+    // Batch being synchronized is abandoned between operations, so that
+    // caller waits at most for operations already running
+    void stopWatching();
+    BOOL isWatching() const;
+
 private:
+    // Save folder contents after scan and reuse content of folders,
+    // that have not changed since, instead of enumerating them again
+    // Disabled: rewriting a file in place does not change the write time
+    // of its folder, so reused entries may be stale; every reused entry
+    // has to be checked against the file or the change journal first
+    static const BOOL USE_SCAN_SNAPSHOT = FALSE;
+
     BOOL folderExists(const CString& folder) const;
 
+    // Both folders exist and differ
+    BOOL canSync() const;
+
+    // Source and destination in the order scanFolders() takes them,
+    // depending on sync direction
+    CString getScanSourceFolder() const;
+    CString getScanDestinationFolder() const;
+
     // Checks if certain SyncManagerOptions apply to file
-    BOOL fileMeetsRequirements(const FileProperties& file) const;
-    
-    FileSet getFilesFromFolder(const CString& folder) const;
-    
-    // Called recursively while scanning
-    void scanFolders(const CString& source,
-                     const CString& destination,
-                     ScanCallback* callback);
+    BOOL fileMeetsRequirements(DWORD attributes) const;
+
+    // Folder content, that scanFolders() merges
+    struct FolderContent
+    {
+        PathNode::ptr folder;
+        FileTable table;
+
+        // Entries, that meet requirements, sorted by FileTable::compareNames()
+        FileTable::Handles files;
+    };
+
+    // Takes file properties from enumeration records, files are not
+    // opened one by one; if scan snapshot is used and folder has not changed,
+    // content is taken from the snapshot without enumeration
+    void readFolder(const PathNode::ptr& folder, FolderContent& content) const;
+
+    // Same as readFolder(), but makes FileProperties of every entry
+    // Result is sorted, see FileList
+    FileList getFilesFromFolder(const PathNode::ptr& folder) const;
+
+    static BOOL readFolderStamp(HANDLE folderHandle, FolderStamp& stamp);
+    static void enumerateFolder(HANDLE folderHandle,
+                                DWORD volumeSerial,
+                                FileTable& entries);
 
-    void enqueueOperation(SyncOperation* operation);
+    // Finds out which of the synchronized folders contains folder
+    BOOL getSnapshotLocation(const CString& folder,
+                             ScanSnapshot::SIDE& side,
+                             CString& relativePath) const;
+
+    // File in local application data, that belongs to the current pair
+    // of folders, e.g. scan snapshot; extension includes the dot
+    CString getPairDataFilePath(LPCTSTR extension) const;
+
+    // Content of folder, that exists only on one side, with all of its
+    // subfolders, read once before copy or remove operations are planned
+    struct FolderTree
+    {
+        FileList files;
+
+        // Content of files[i], if it is a folder, otherwise NULL
+        std::vector <std::unique_ptr <FolderTree>> subfolders;
+    };
+
+    void readFolderTree(const PathNode::ptr& folder, FolderTree& tree) const;
+
+    // Operations found while scanning one pair of folders
+    // Subfolders (and files, whose content is compared) are scanned
+    // by separate tasks into their own nodes,
+    // which are merged back at their position once the scan is over,
+    // so the queue keeps the same order as sequential scan would give
+    struct ScanNode
+    {
+        OperationQueue operations;
+
+        // Position in operations, at which subfolder operations are placed
+        std::vector <std::pair <size_t, std::unique_ptr <ScanNode>>> subfolders;
+    };
+
+    // Scans pair of folders into node and submits a task to m_scanPool
+    // for every pair of subfolders, if scanSubfolders is set
+    // Sorted folder contents are merge-joined in a single linear pass
+    void scanFolders(const PathNode::ptr& source,
+                     const PathNode::ptr& destination,
+                     ScanCallback* callback,
+                     ScanNode& node,
+                     BOOL scanSubfolders);
+
+    // Scans the whole tree into queue, reading and saving the snapshot
+    // if USE_SCAN_SNAPSHOT is set
+    void scanTree(ScanCallback* callback, OperationQueue& operations);
+
+    // Scans pairs of folders at given paths, relative to source and
+    // destination, in parallel and appends found operations to queue
+    void planFolders(const std::vector <CString>& relativeFolders,
+                     BOOL scanSubfolders,
+                     ScanCallback* callback,
+                     OperationQueue& operations);
+
+    // Appends node operations to queue in depth-first order
+    void mergeScanResults(ScanNode& node, OperationQueue& operations);
+
+    // Replaces copies of moved files and their removals with moves;
+    // files are moved only when sync removes files on one side
+    void detectMoves(OperationQueue& operations);
+
+    // Skip forbidden operations; callback may be NULL
+    // Callback is never called from several threads at once
+    void executeOperations(OperationQueue& operations, SyncCallback* callback);
+    void executeOperation(SyncOperation::ptr& operation, SyncCallback* callback);
+
+    // Gives folders created by executed operations times of original ones
+    void restoreFolderTimes();
+
+    // Takes operations from m_operationStream until it is closed
+    void executeOperationStream(SyncCallback* callback);
+
+    // Puts next operation into argument, returns FALSE when there is none
+    using OperationSource = std::function <BOOL (SyncOperation::ptr&)>;
+
+    // Copies of small files are executed in batches, see CopyBatcher
+    void executeOperationSource(const OperationSource& nextOperation,
+                                SyncCallback* callback);
+
+    void resetSyncStatistics();
+
+    // Called by watchers; plans and executes operations for changed folders
+    void syncChanges(const FolderChanges& changes);
+
+    void enqueueOperation(SyncOperation* operation, ScanNode& node);
 
     // Used in scanFolders(); each call enqueueOperation() if needed
     void manageCopyOperation(const FileProperties& fileToCopy,
-                             const CString& destinationFolder);
+                             const CString& destinationFolder,
+                             ScanNode& node);
     void manageReplaceOperation(const FileProperties& originalFile,
-                                const FileProperties& fileToReplace);
-    void manageRemoveOperation(const FileProperties& fileToRemove);
+                                const FileProperties& fileToReplace,
+                                ScanNode& node);
+
+    // Comparison of these files has to read them, see ContentComparator
+    BOOL needsContentComparison(const FileProperties& firstFile,
+                                const FileProperties& secondFile) const;
+    void manageRemoveOperation(const FileProperties& fileToRemove,
+                               ScanNode& node);
+
+    // Plan operations for folder content from FolderTree
+    void manageFolderCopy(const FileProperties& folderToCopy,
+                          const FolderTree& content,
+                          const CString& destinationFolder,
+                          ScanNode& node);
+    void manageFolderRemove(const FileProperties& folderToRemove,
+                            const FolderTree& content,
+                            ScanNode& node);
 
     void clearOperationQueue();
 
@@ -114,8 +364,71 @@ private:
 
     OperationQueue m_syncOperations;
 
+    // Exists only while scan() runs
+    std::unique_ptr <WorkStealingPool> m_scanPool;
+
+    // Exists only while scanAndSync() runs; if set, enqueueOperation()
+    // passes operations to the executing thread instead of ScanNode
+    // Scan tasks are created only for folders, that exist on both sides,
+    // and each task produces operations in parent-before-child order,
+    // so executing them in order of arrival is safe
+    std::unique_ptr <OperationStream> m_operationStream;
+
+    // Operations are executed on several threads, see SyncManagerOptions::syncThreads
+    std::mutex m_syncCallbackMutex;
+
+    // Shared by executing threads; rates are kept here rather than
+    // in m_options, so that they can change during sync
+    TokenBucket m_byteLimit;
+    TokenBucket m_operationLimit;
+
+    // Folders created during execution; their times are restored
+    // in one pass once all operations are executed
+    OperationQueue m_createdFolders;
+    std::mutex m_createdFoldersMutex;
+
+    // Watch mode; destination is watched only for SYNC_DIRECTION::BOTH
+    std::unique_ptr <FolderWatcher> m_sourceWatcher;
+    std::unique_ptr <FolderWatcher> m_destinationWatcher;
+    WatchCallback m_watchCallback;
+
+    // Both watchers may report changes at once
+    std::mutex m_watchMutex;
+
+    // Set while watching stops; scan and execution check it
+    // before each folder and operation
+    std::atomic <bool> m_stoppingWatch;
+
+    // Exist only while scan() runs with USE_SCAN_SNAPSHOT
+    std::unique_ptr <ScanSnapshot> m_previousSnapshot;
+    std::unique_ptr <ScanSnapshotWriter> m_snapshotWriter;
+
+    // Exist only while folders are scanned with content comparison
+    std::unique_ptr <HashCache> m_hashCache;
+    std::unique_ptr <ContentComparator> m_contentComparator;
+
+    // Updated concurrently by scanning threads, see ScanStatistics
+    mutable std::atomic <ULONGLONG> m_statCallsAvoided;
+    mutable std::atomic <ULONGLONG> m_foldersReused;
+    mutable std::atomic <ULONGLONG> m_folderOpens;
+    std::atomic <ULONGLONG> m_hashCacheHits;
+    std::atomic <ULONGLONG> m_hashCacheMisses;
+    std::atomic <ULONGLONG> m_contentByMetadata;
+    std::atomic <ULONGLONG> m_contentByCache;
+    std::atomic <ULONGLONG> m_contentBySample;
+    std::atomic <ULONGLONG> m_contentByFullRead;
+    std::atomic <ULONGLONG> m_movesFound;
+
+    // Updated concurrently by executing threads, see SyncStatistics
+    std::atomic <ULONGLONG> m_deltaFiles;
+    std::atomic <ULONGLONG> m_deltaBytesWritten;
+    std::atomic <ULONGLONG> m_deltaBytesSkipped;
+
     SYNC_DIRECTION m_syncDirection;
     SyncManagerOptions m_options;
     FileComparisonParameters m_compareParameters;
+
+    // Made from m_compareParameters, whenever they are set
+    FileComparator m_fileComparator;
 };
 
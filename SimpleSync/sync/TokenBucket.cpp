@@ -0,0 +1,81 @@
+#include "stdafx.h"
+#include "TokenBucket.h"
+#include <algorithm>
+#include <chrono>
+
+
+
+TokenBucket::TokenBucket(ULONGLONG rate)
+    : m_rate(rate),
+      m_tokens((double)rate),
+      m_lastRefill(GetTickCount64())
+{
+}
+
+TokenBucket::~TokenBucket()
+{
+}
+
+
+
+void TokenBucket::setRate(ULONGLONG rate)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    refill();
+
+    // Limit that has just been set starts with a full bucket
+    if (m_rate == 0)
+        m_tokens = (double)rate;
+
+    m_rate = rate;
+    m_tokens = (std::min)(m_tokens, (double)rate);
+
+    // Waiting threads recount their wait with the new rate
+    m_rateChanged.notify_all();
+}
+
+ULONGLONG TokenBucket::getRate() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_rate;
+}
+
+void TokenBucket::acquire(ULONGLONG count)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;)
+    {
+        if (m_rate == 0 || count == 0)
+            return;
+
+        refill();
+
+        // Large request waits for a full bucket, not for count tokens,
+        // which might never accumulate
+        double needed = (std::min)((double)count, (double)m_rate);
+        if (m_tokens >= needed)
+        {
+            m_tokens -= (double)count;
+            return;
+        }
+
+        double waitTime = (needed - m_tokens) * 1000.0 / (double)m_rate;
+        ULONGLONG milliseconds = (std::max)((ULONGLONG)waitTime, (ULONGLONG)1);
+
+        m_rateChanged.wait_for(lock, std::chrono::milliseconds(milliseconds));
+    }
+}
+
+
+
+void TokenBucket::refill()
+{
+    ULONGLONG now = GetTickCount64();
+    ULONGLONG elapsed = now - m_lastRefill;
+    m_lastRefill = now;
+
+    double added = (double)elapsed * (double)m_rate / 1000.0;
+    m_tokens = (std::min)(m_tokens + added, (double)m_rate);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+
+
+
+// Limits rate of something (bytes, operations) taken by several threads
+// Tokens accumulate at given rate up to one second worth of them
+// Request larger than that passes as soon as bucket is full and leaves
+// bucket in debt, so average rate holds for requests of any size
+class TokenBucket
+{
+public:
+    // rate - tokens per second; 0 - no limit
+    TokenBucket(ULONGLONG rate = 0);
+    ~TokenBucket();
+
+    // May be called while other threads wait in acquire()
+    void setRate(ULONGLONG rate);
+    ULONGLONG getRate() const;
+
+    // Blocks until count tokens can be taken
+    void acquire(ULONGLONG count);
+
+private:
+    // Adds tokens for time passed since the last refill
+    void refill();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_rateChanged;
+
+    ULONGLONG m_rate;
+
+    // Negative while in debt
+    double m_tokens;
+    ULONGLONG m_lastRefill;
+};
@@ -0,0 +1,138 @@
+#include "stdafx.h"
+#include "WorkStealingPool.h"
+
+
+
+// Identifies pool and queue of the current worker thread
+static thread_local const WorkStealingPool* t_workerPool = nullptr;
+static thread_local size_t t_workerIndex = 0;
+
+
+WorkStealingPool::WorkStealingPool(size_t threadCount)
+    : m_queuedTasks(0),
+      m_pendingTasks(0),
+      m_nextQueue(0),
+      m_stopping(FALSE)
+{
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
+
+    for (size_t i = 0; i < threadCount; ++i)
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+
+    for (size_t i = 0; i < threadCount; ++i)
+        m_threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_stopping = TRUE;
+    }
+    m_taskAvailable.notify_all();
+
+    for (std::thread& thread : m_threads)
+        thread.join();
+}
+
+
+
+void WorkStealingPool::submit(Task task)
+{
+    size_t index;
+    if (t_workerPool == this)
+        index = t_workerIndex;
+    else
+        index = m_nextQueue++ % m_queues.size();
+
+    ++m_pendingTasks;
+    {
+        std::lock_guard<std::mutex> lock(m_queues[index]->m_mutex);
+        m_queues[index]->m_tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        ++m_queuedTasks;
+    }
+    m_taskAvailable.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_stateMutex);
+    m_allTasksDone.wait(lock, [this]() { return m_pendingTasks == 0; });
+}
+
+size_t WorkStealingPool::getThreadCount() const
+{
+    return m_threads.size();
+}
+
+
+
+void WorkStealingPool::workerLoop(size_t index)
+{
+    t_workerPool = this;
+    t_workerIndex = index;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_stateMutex);
+            m_taskAvailable.wait(lock, [this]() {
+                return m_stopping || m_queuedTasks > 0;
+            });
+
+            if (m_stopping && m_queuedTasks == 0)
+                return;
+        }
+
+        Task task;
+        if (!popTask(index, task) && !stealTask(index, task))
+            continue;
+
+        --m_queuedTasks;
+        task();
+
+        if (--m_pendingTasks == 0)
+        {
+            std::lock_guard<std::mutex> lock(m_stateMutex);
+            m_allTasksDone.notify_all();
+        }
+    }
+}
+
+BOOL WorkStealingPool::popTask(size_t index, Task& task)
+{
+    WorkerQueue& queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.m_mutex);
+
+    if (queue.m_tasks.empty())
+        return FALSE;
+
+    task = std::move(queue.m_tasks.back());
+    queue.m_tasks.pop_back();
+    return TRUE;
+}
+
+BOOL WorkStealingPool::stealTask(size_t index, Task& task)
+{
+    for (size_t i = 1; i < m_queues.size(); ++i)
+    {
+        WorkerQueue& victim = *m_queues[(index + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.m_mutex);
+
+        if (victim.m_tasks.empty())
+            continue;
+
+        task = std::move(victim.m_tasks.front());
+        victim.m_tasks.pop_front();
+        return TRUE;
+    }
+
+    return FALSE;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+
+
+// Fixed set of worker threads, each one owns a queue of tasks
+// Worker takes tasks from the back of its own queue (depth-first),
+// idle worker steals from the front of other queues (oldest, biggest tasks)
+class WorkStealingPool
+{
+public:
+    using Task = std::function <void ()>;
+
+    // threadCount == 0 means one thread per hardware thread
+    WorkStealingPool(size_t threadCount = 0);
+    ~WorkStealingPool();
+
+    // Can be called from any thread, including workers of this pool;
+    // task submitted by worker is placed into its own queue
+    void submit(Task task);
+
+    // Blocks until every submitted task (and tasks submitted by them) is done
+    // Must not be called from worker threads
+    void wait();
+
+    size_t getThreadCount() const;
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex m_mutex;
+        std::deque <Task> m_tasks;
+    };
+
+    void workerLoop(size_t index);
+
+    BOOL popTask(size_t index, Task& task);
+    BOOL stealTask(size_t index, Task& task);
+
+    std::vector <std::unique_ptr <WorkerQueue>> m_queues;
+    std::vector <std::thread> m_threads;
+
+    // Tasks waiting in queues
+    std::atomic <size_t> m_queuedTasks;
+    // Tasks submitted, but not finished yet
+    std::atomic <size_t> m_pendingTasks;
+    // Round-robin position for tasks submitted from outside the pool
+    std::atomic <size_t> m_nextQueue;
+
+    std::mutex m_stateMutex;
+    std::condition_variable m_taskAvailable;
+    std::condition_variable m_allTasksDone;
+    BOOL m_stopping;
+};